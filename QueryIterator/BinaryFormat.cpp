@@ -0,0 +1,106 @@
+#include <unistd.h>
+#include "BinaryFormat.h"
+#include "dbexceptions.h"
+
+//----------------------------------------------------------------------
+
+// BinaryWriter
+
+void BinaryWriter::bytes(const void* data, size_t n)
+{
+    if (n > 0 && fwrite(data, 1, n, _file) != n) {
+        throw TableException("Can't write " + _temporary_path);
+    }
+}
+
+void BinaryWriter::u32(uint32_t x)
+{
+    bytes(&x, sizeof(x));
+}
+
+void BinaryWriter::u64(uint64_t x)
+{
+    bytes(&x, sizeof(x));
+}
+
+void BinaryWriter::str(const string& s)
+{
+    u32((uint32_t) s.size());
+    bytes(s.data(), s.size());
+}
+
+void BinaryWriter::commit()
+{
+    if (fflush(_file) != 0 || fsync(fileno(_file)) != 0) {
+        throw TableException("Can't write " + _temporary_path);
+    }
+    fclose(_file);
+    _file = NULL;
+    if (rename(_temporary_path.c_str(), _path.c_str()) != 0) {
+        unlink(_temporary_path.c_str());
+        throw TableException("Can't rename " + _temporary_path + " to " + _path);
+    }
+}
+
+BinaryWriter::BinaryWriter(const string& path)
+    : _path(path),
+      _temporary_path(path + ".tmp"),
+      _file(fopen(_temporary_path.c_str(), "wb"))
+{
+    if (_file == NULL) {
+        throw TableException("Can't create " + _temporary_path);
+    }
+    setvbuf(_file, NULL, _IOFBF, 1 << 20);
+}
+
+BinaryWriter::~BinaryWriter()
+{
+    if (_file != NULL) {
+        fclose(_file);
+        unlink(_temporary_path.c_str());
+    }
+}
+
+//----------------------------------------------------------------------
+
+// BinaryReader
+
+const char* BinaryReader::take(size_t n)
+{
+    if (remaining() < n) {
+        throw TableException("Truncated file");
+    }
+    const char* start = _position;
+    _position += n;
+    return start;
+}
+
+size_t BinaryReader::remaining() const
+{
+    return (size_t) (_end - _position);
+}
+
+uint32_t BinaryReader::u32()
+{
+    uint32_t x;
+    memcpy(&x, take(sizeof(x)), sizeof(x));
+    return x;
+}
+
+uint64_t BinaryReader::u64()
+{
+    uint64_t x;
+    memcpy(&x, take(sizeof(x)), sizeof(x));
+    return x;
+}
+
+string BinaryReader::str()
+{
+    uint32_t n = u32();
+    return string(take(n), n);
+}
+
+BinaryReader::BinaryReader(const char* start, size_t size)
+    : _position(start),
+      _end(start + size)
+{}
@@ -0,0 +1,103 @@
+#ifndef BINARYFORMAT_H
+#define BINARYFORMAT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+// Helpers for the binary file formats, (snapshots and indexes). Integers are written in the byte order of the
+// machine; files start with a byte order mark so that readers can reject files from machines that differ.
+
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+static const char INDEX_FILE_MAGIC[8] = {'Q', 'I', 'I', 'N', 'D', 'E', 'X', 'F'};
+static const uint32_t INDEX_FILE_VERSION = 1;
+
+// Writes a file under a temporary name. commit() makes the file durable and renames it to its final name, so a
+// crash never leaves a partially written file under that name. If the writer is destroyed without a commit, the
+// temporary file is removed. All methods throw TableException on I/O errors.
+class BinaryWriter
+{
+public:
+    void bytes(const void* data, size_t n);
+
+    void u32(uint32_t x);
+
+    void u64(uint64_t x);
+
+    // u32 length, then the bytes of s
+    void str(const string& s);
+
+    void commit();
+
+    explicit BinaryWriter(const string& path);
+
+    ~BinaryWriter();
+
+    BinaryWriter(const BinaryWriter&) = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+private:
+    string _path;
+    string _temporary_path;
+    FILE* _file;
+};
+
+// Reads values from a buffer, (usually a MappedFile), throwing TableException on reading past its end.
+class BinaryReader
+{
+public:
+    // Return the next n bytes, and move past them.
+    const char* take(size_t n);
+
+    size_t remaining() const;
+
+    uint32_t u32();
+
+    uint64_t u64();
+
+    string str();
+
+    BinaryReader(const char* start, size_t size);
+
+private:
+    const char* _position;
+    const char* _end;
+};
+
+// Read the i-th u64 of an array that may not be aligned.
+inline uint64_t u64_at(const char* array, uint64_t i)
+{
+    uint64_t x;
+    memcpy(&x, array + i * sizeof(x), sizeof(x));
+    return x;
+}
+
+// FNV-1a, for the fingerprints recorded in files, and for hashing values in memory. A hash starts at FNV_OFFSET.
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// Add value to hash, followed by a terminator, so that ("ab", "c") and ("a", "bc") hash differently.
+inline uint64_t fnv_add(uint64_t hash, const string& value)
+{
+    for (char c : value) {
+        hash = (hash ^ (unsigned char) c) * FNV_PRIME;
+    }
+    return (hash ^ 0xff) * FNV_PRIME;
+}
+
+// Spread the bits of an FNV-1a hash, (whose high bits are weak), over all 64 bits.
+inline uint64_t fnv_finish(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+#endif //BINARYFORMAT_H
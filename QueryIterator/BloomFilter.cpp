@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cmath>
+#include "BloomFilter.h"
+#include "BinaryFormat.h"
+#include "Row.h"
+
+void BloomFilter::add(uint64_t hash)
+{
+    uint64_t delta = (hash >> 33) | (hash << 31);
+    for (unsigned i = 0; i < _n_hashes; i++) {
+        uint64_t bit = hash % _n_bits;
+        _bits[bit / 64] |= uint64_t(1) << (bit % 64);
+        hash += delta;
+    }
+}
+
+bool BloomFilter::may_contain(uint64_t hash) const
+{
+    uint64_t delta = (hash >> 33) | (hash << 31);
+    for (unsigned i = 0; i < _n_hashes; i++) {
+        uint64_t bit = hash % _n_bits;
+        if ((_bits[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+            return false;
+        }
+        hash += delta;
+    }
+    return true;
+}
+
+BloomFilter::BloomFilter(size_t n_keys, unsigned bits_per_key)
+{
+    if (bits_per_key == 0) {
+        bits_per_key = 1;
+    }
+    _n_bits = max((uint64_t) 64, (uint64_t) n_keys * bits_per_key);
+    _bits.assign((_n_bits + 63) / 64, 0);
+    // k = ln 2 * bits per key minimizes the false positive rate.
+    _n_hashes = max(1u, (unsigned) lround(bits_per_key * 0.69));
+}
+
+uint64_t key_hash(const Row* row, const ColumnSelector& key_columns)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (unsigned i = 0; i < key_columns.n_selected(); i++) {
+        hash = fnv_add(hash, row->at(key_columns.selected(i)));
+    }
+    return fnv_finish(hash);
+}
@@ -0,0 +1,34 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <cstdint>
+#include <vector>
+#include "ColumnSelector.h"
+
+using namespace std;
+
+class Row;
+
+// A set of hashes that may report false positives, but no false negatives. Each hash sets k bits, derived from the
+// hash by double hashing. With bits_per_key bits per key added, the false positive rate is about
+// 0.6185 ^ bits_per_key, (about 1% for the default of 10).
+class BloomFilter
+{
+public:
+    void add(uint64_t hash);
+
+    bool may_contain(uint64_t hash) const;
+
+    // A filter sized for n_keys keys
+    explicit BloomFilter(size_t n_keys = 0, unsigned bits_per_key = 10);
+
+private:
+    vector<uint64_t> _bits;
+    uint64_t _n_bits;
+    unsigned _n_hashes;
+};
+
+// Hash of the selected columns of row. Rows with equal values in the selected columns, (in order), have equal hashes.
+uint64_t key_hash(const Row* row, const ColumnSelector& key_columns);
+
+#endif //BLOOMFILTER_H
@@ -0,0 +1,221 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "BufferPool.h"
+#include "dbexceptions.h"
+
+const size_t BufferPool::PAGE_SIZE;
+
+//----------------------------------------------------------------------
+
+// BufferPool
+
+char* BufferPool::pin(PageId page)
+{
+    lock_guard<mutex> lock(_lock);
+    if (page >= _n_pages) {
+        throw TableException("No such page");
+    }
+    auto found = _page_frames.find(page);
+    size_t frame;
+    if (found != _page_frames.end()) {
+        frame = found->second;
+    } else {
+        frame = victim();
+        ssize_t n = pread(_fd, data(frame), PAGE_SIZE, (off_t) page * PAGE_SIZE);
+        if (n != (ssize_t) PAGE_SIZE) {
+            _frames.at(frame).used = false;
+            throw TableException("Can't read " + _path);
+        }
+        _n_reads++;
+        _frames.at(frame).page = page;
+        _page_frames.emplace(page, frame);
+    }
+    Frame& f = _frames.at(frame);
+    f.pins++;
+    f.referenced = true;
+    return data(frame);
+}
+
+void BufferPool::unpin(PageId page, bool dirty)
+{
+    lock_guard<mutex> lock(_lock);
+    Frame& frame = _frames.at(_page_frames.at(page));
+    frame.pins--;
+    frame.dirty = frame.dirty || dirty;
+}
+
+PageId BufferPool::allocate()
+{
+    lock_guard<mutex> lock(_lock);
+    size_t frame = victim();
+    PageId page = _n_pages;
+    memset(data(frame), 0, PAGE_SIZE);
+    // Extend the file now, so that reading the page back works even before it is written.
+    if (ftruncate(_fd, (off_t) (page + 1) * PAGE_SIZE) != 0) {
+        _frames.at(frame).used = false;
+        throw TableException("Can't extend " + _path);
+    }
+    _n_pages++;
+    Frame& f = _frames.at(frame);
+    f.page = page;
+    f.pins = 1;
+    f.dirty = true;
+    f.referenced = true;
+    _page_frames.emplace(page, frame);
+    return page;
+}
+
+void BufferPool::flush()
+{
+    lock_guard<mutex> lock(_lock);
+    for (size_t frame = 0; frame < _frames.size(); frame++) {
+        if (_frames.at(frame).used && _frames.at(frame).dirty) {
+            write_frame(frame);
+        }
+    }
+}
+
+size_t BufferPool::n_frames() const
+{
+    return _frames.size();
+}
+
+unsigned long BufferPool::n_reads() const
+{
+    lock_guard<mutex> lock(_lock);
+    return _n_reads;
+}
+
+unsigned long BufferPool::n_writes() const
+{
+    lock_guard<mutex> lock(_lock);
+    return _n_writes;
+}
+
+// Find a frame for a new page, evicting an unpinned page if necessary. The frame is returned marked used, but not
+// yet in _page_frames. Called with _lock held.
+size_t BufferPool::victim()
+{
+    // Two full sweeps: the first may only clear reference bits.
+    for (size_t step = 0; step < 2 * _frames.size(); step++) {
+        size_t frame = _hand;
+        _hand = (_hand + 1) % _frames.size();
+        Frame& f = _frames.at(frame);
+        if (!f.used) {
+            f = Frame{0, 0, true, false, false};
+            return frame;
+        }
+        if (f.pins > 0) {
+            continue;
+        }
+        if (f.referenced) {
+            f.referenced = false;
+            continue;
+        }
+        if (f.dirty) {
+            write_frame(frame);
+        }
+        _page_frames.erase(f.page);
+        f = Frame{0, 0, true, false, false};
+        return frame;
+    }
+    throw TableException("All buffer pool frames are pinned");
+}
+
+char* BufferPool::data(size_t frame)
+{
+    return _memory.data() + frame * PAGE_SIZE;
+}
+
+void BufferPool::write_frame(size_t frame)
+{
+    Frame& f = _frames.at(frame);
+    if (pwrite(_fd, data(frame), PAGE_SIZE, (off_t) f.page * PAGE_SIZE) != (ssize_t) PAGE_SIZE) {
+        throw TableException("Can't write " + _path);
+    }
+    f.dirty = false;
+    _n_writes++;
+}
+
+BufferPool::BufferPool(const string& path, size_t n_frames)
+    : _path(path),
+      _fd(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)),
+      _frames(n_frames == 0 ? 1 : n_frames, Frame{0, 0, false, false, false}),
+      _memory(_frames.size() * PAGE_SIZE),
+      _hand(0),
+      _n_pages(0),
+      _n_reads(0),
+      _n_writes(0)
+{
+    if (_fd < 0) {
+        throw TableException("Can't create " + path);
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    close(_fd);
+    unlink(_path.c_str());
+}
+
+//----------------------------------------------------------------------
+
+// SlottedPage
+
+static const size_t HEADER_SIZE = 2 * sizeof(uint16_t);
+static const size_t SLOT_SIZE = 2 * sizeof(uint16_t);
+
+static uint16_t u16_at(const char* p)
+{
+    uint16_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static void put_u16(char* p, size_t x)
+{
+    uint16_t y = (uint16_t) x;
+    memcpy(p, &y, sizeof(y));
+}
+
+void SlottedPage::init(char* page)
+{
+    put_u16(page, 0);
+    put_u16(page + sizeof(uint16_t), BufferPool::PAGE_SIZE);
+}
+
+unsigned SlottedPage::n_slots(const char* page)
+{
+    return u16_at(page);
+}
+
+int SlottedPage::insert(char* page, const char* record, size_t size)
+{
+    unsigned n = n_slots(page);
+    size_t records_start = u16_at(page + sizeof(uint16_t));
+    size_t slots_end = HEADER_SIZE + (n + 1) * SLOT_SIZE;
+    if (records_start < slots_end || records_start - slots_end < size) {
+        return -1;
+    }
+    records_start -= size;
+    memcpy(page + records_start, record, size);
+    char* slot = page + HEADER_SIZE + n * SLOT_SIZE;
+    put_u16(slot, records_start);
+    put_u16(slot + sizeof(uint16_t), size);
+    put_u16(page, n + 1);
+    put_u16(page + sizeof(uint16_t), records_start);
+    return (int) n;
+}
+
+const char* SlottedPage::record(const char* page, unsigned slot, size_t* size)
+{
+    const char* entry = page + HEADER_SIZE + slot * SLOT_SIZE;
+    *size = u16_at(entry + sizeof(uint16_t));
+    return page + u16_at(entry);
+}
+
+size_t SlottedPage::max_record_size()
+{
+    return BufferPool::PAGE_SIZE - HEADER_SIZE - SLOT_SIZE;
+}
@@ -0,0 +1,99 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+typedef uint32_t PageId;
+
+// A fixed number of page-sized frames caching the pages of a data file. A page is pinned while in use, and pinned
+// pages stay in their frames. When a page that isn't cached is pinned, the frame of an unpinned page is reused,
+// chosen by the clock algorithm: a hand sweeps the frames, skipping (and clearing the reference bit of) recently
+// used ones. A dirty page is written back to the file before its frame is reused. Methods are thread-safe, and
+// throw TableException on I/O errors, or if every frame is pinned.
+//
+// The data file is scratch space for tables that don't fit in memory: it is created empty by the constructor, and
+// its contents don't survive the pool. (Durability comes from the write-ahead log.)
+class BufferPool
+{
+public:
+    static const size_t PAGE_SIZE = 8192;
+
+    // Pin the page, reading it into a frame if it isn't cached, and return its bytes, (valid until it is unpinned).
+    char* pin(PageId page);
+
+    // Unpin a page pinned by pin or allocate. dirty indicates that the page was modified.
+    void unpin(PageId page, bool dirty);
+
+    // Add a zero-filled page at the end of the file. The new page is pinned, (as by pin).
+    PageId allocate();
+
+    // Write all dirty pages to the file.
+    void flush();
+
+    size_t n_frames() const;
+
+    // The number of pages read from, and written to the file
+    unsigned long n_reads() const;
+    unsigned long n_writes() const;
+
+    BufferPool(const string& path, size_t n_frames);
+
+    // Removes the data file.
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+private:
+    struct Frame
+    {
+        PageId page;
+        unsigned pins;
+        bool used;          // Holds a page
+        bool dirty;
+        bool referenced;    // Pinned since the clock hand last passed
+    };
+
+    size_t victim();
+    char* data(size_t frame);
+    void write_frame(size_t frame);
+
+private:
+    string _path;
+    int _fd;
+    vector<Frame> _frames;
+    vector<char> _memory;
+    unordered_map<PageId, size_t> _page_frames;
+    size_t _hand;
+    PageId _n_pages;
+    unsigned long _n_reads;
+    unsigned long _n_writes;
+    mutable mutex _lock;
+};
+
+// A slotted page: a header (u16 number of slots, u16 start of the record area), then an array of slots, (u16 offset
+// and u16 length of each record), growing towards the records, which are packed at the end of the page.
+namespace SlottedPage
+{
+    // Initialize an empty page
+    void init(char* page);
+
+    unsigned n_slots(const char* page);
+
+    // Add a record, returning its slot, or -1 if the page doesn't have room.
+    int insert(char* page, const char* record, size_t size);
+
+    // The record in the given slot
+    const char* record(const char* page, unsigned slot, size_t* size);
+
+    // The largest record that fits in an empty page
+    size_t max_record_size();
+}
+
+#endif //BUFFERPOOL_H
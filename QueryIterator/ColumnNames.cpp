@@ -1,4 +1,5 @@
 #include "ColumnNames.h"
+#include "dbexceptions.h"
 
 int ColumnNames::position(const string &name) const
 {
@@ -14,3 +15,17 @@ int ColumnNames::position(const string &name) const
 ColumnNames::ColumnNames(const initializer_list<string>& elements)
         : vector<string>(elements)
 {}
+
+unsigned ColumnHandle::position() const
+{
+    return _position;
+}
+
+ColumnHandle::ColumnHandle(const ColumnNames& columns, const string& name)
+{
+    int position = columns.position(name);
+    if (position == -1) {
+        throw RowException("Unknown column");
+    }
+    _position = (unsigned) position;
+}
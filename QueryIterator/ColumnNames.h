@@ -15,5 +15,20 @@ public:
     ColumnNames(const initializer_list<string>& elements);
 };
 
+// A column resolved to its position in a schema, once, so that the values of rows with that schema, (including
+// intermediate rows), can be accessed by Row::value(handle) with no search of the column names.
+class ColumnHandle
+{
+public:
+    // The column's position
+    unsigned position() const;
+
+    // Resolve the named column of columns. Throws RowException if there is no such column.
+    ColumnHandle(const ColumnNames& columns, const string& name);
+
+private:
+    unsigned _position;
+};
+
 
 #endif //COLUMNNAMES_H
@@ -27,32 +27,29 @@ unsigned ColumnSelector::unselected(int i) const
 }
 
 ColumnSelector::ColumnSelector(unsigned n_columns, const initializer_list<unsigned>& selected_positions)
+    : ColumnSelector(n_columns, vector<unsigned>(selected_positions))
+{}
+
+ColumnSelector::ColumnSelector(unsigned n_columns, const vector<unsigned>& selected_positions)
     : _n_columns(n_columns),
       _n_selected((unsigned) selected_positions.size()),
-      _n_unselected(_n_columns - _n_selected),
+      _n_unselected(0),
       _selected(new unsigned[_n_selected]),
-      _unselected(new unsigned[_n_unselected])
+      _unselected(new unsigned[_n_columns])
 {
-    assert(_n_selected <= _n_columns);
     // Initialize _selected
-    {
-        auto s = selected_positions.begin();
-        unsigned i = 0;
-        while (s != selected_positions.end()) {
-            _selected[i++] = *s++;
-        }
+    for (unsigned i = 0; i < _n_selected; i++) {
+        assert(selected_positions[i] < _n_columns);
+        _selected[i] = selected_positions[i];
     }
-    // Compute _unselected
-    {
-        unsigned u = 0;
-        for (unsigned i = 0; i < _n_columns; i++) {
-            bool i_selected = false;
-            for (unsigned s = 0; s < _n_selected; s++) {
-                i_selected = i_selected || _selected[s] == i;
-            }
-            if (!i_selected) {
-                _unselected[u++] = i;
-            }
+    // Compute _unselected, (a column may be selected more than once, e.g. by a projection).
+    for (unsigned i = 0; i < _n_columns; i++) {
+        bool i_selected = false;
+        for (unsigned s = 0; s < _n_selected; s++) {
+            i_selected = i_selected || _selected[s] == i;
+        }
+        if (!i_selected) {
+            _unselected[_n_unselected++] = i;
         }
     }
 }
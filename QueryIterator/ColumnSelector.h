@@ -2,6 +2,7 @@
 #define COLUMNSELECTOR_H
 
 #include <initializer_list>
+#include <vector>
 
 using namespace std;
 
@@ -14,6 +15,7 @@ public:
     unsigned selected(int i) const;
     unsigned unselected(int i) const;
     ColumnSelector(unsigned n_columns, const initializer_list<unsigned>& selected_positions);
+    ColumnSelector(unsigned n_columns, const vector<unsigned>& selected_positions);
     virtual ~ColumnSelector();
 
 private:
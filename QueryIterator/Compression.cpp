@@ -0,0 +1,597 @@
+#include <algorithm>
+#include <cstdint>
+#include "Compression.h"
+#include "Scheduler.h"
+#include "Table.h"
+
+// Values per DELTA block. Decoding a value starts at the beginning of its block.
+static const size_t DELTA_BLOCK = 128;
+
+// The widest integers DELTA handles, in decimal digits, so that every value fits in an int64_t.
+static const size_t DELTA_MAX_DIGITS = 18;
+
+size_t string_bytes(const string& s)
+{
+    // Short strings are stored inside the string object.
+    return sizeof(string) + (s.capacity() > 15 ? s.capacity() + 1 : 0);
+}
+
+static bool in_range(const string& value, const string& lo, const string& hi)
+{
+    return lo <= value && value <= hi;
+}
+
+// Unsigned integers, each stored in the given number of bits.
+class BitPacker
+{
+public:
+    void append(uint64_t value, unsigned width)
+    {
+        if (width == 0) {
+            return;
+        }
+        size_t word = _bits / 64;
+        unsigned shift = _bits % 64;
+        if (word == _words.size()) {
+            _words.push_back(0);
+        }
+        _words[word] |= value << shift;
+        if (shift + width > 64) {
+            _words.push_back(value >> (64 - shift));
+        }
+        _bits += width;
+    }
+
+    uint64_t at(size_t bit, unsigned width) const
+    {
+        if (width == 0) {
+            return 0;
+        }
+        size_t word = bit / 64;
+        unsigned shift = bit % 64;
+        uint64_t value = _words[word] >> shift;
+        if (shift + width > 64) {
+            value |= _words[word + 1] << (64 - shift);
+        }
+        return width == 64 ? value : value & ((uint64_t(1) << width) - 1);
+    }
+
+    size_t bits() const
+    {
+        return _bits;
+    }
+
+    void shrink()
+    {
+        _words.shrink_to_fit();
+    }
+
+    size_t memory_bytes() const
+    {
+        return sizeof(*this) + _words.capacity() * sizeof(uint64_t);
+    }
+
+    BitPacker()
+        : _bits(0)
+    {}
+
+private:
+    vector<uint64_t> _words;
+    size_t _bits;
+};
+
+static unsigned bit_width(uint64_t value)
+{
+    unsigned width = 0;
+    while (value != 0) {
+        width++;
+        value >>= 1;
+    }
+    return width;
+}
+
+//----------------------------------------------------------------------
+
+// CompressedColumn
+
+void CompressedColumn::filter(size_t begin,
+                              size_t end,
+                              const string& lo,
+                              const string& hi,
+                              vector<char>& selected) const
+{
+    vector<string> values;
+    decode(begin, end, values);
+    for (size_t i = 0; i < values.size(); i++) {
+        if (selected[i] && !in_range(values[i], lo, hi)) {
+            selected[i] = 0;
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+
+// PLAIN
+
+class PlainColumn : public CompressedColumn
+{
+public:
+    Codec codec() const override
+    {
+        return PLAIN;
+    }
+
+    size_t size() const override
+    {
+        return _values.size();
+    }
+
+    size_t memory_bytes() const override
+    {
+        size_t bytes = sizeof(*this);
+        for (const string& value : _values) {
+            bytes += string_bytes(value);
+        }
+        return bytes;
+    }
+
+    void decode(size_t begin, size_t end, vector<string>& values) const override
+    {
+        values.insert(values.end(), _values.begin() + begin, _values.begin() + end);
+    }
+
+    PlainColumn(const RowList& rows, unsigned position)
+    {
+        _values.reserve(rows.size());
+        for (const Row* row : rows) {
+            _values.push_back(row->at(position));
+        }
+    }
+
+private:
+    vector<string> _values;
+};
+
+//----------------------------------------------------------------------
+
+// RUN_LENGTH
+
+class RunLengthColumn : public CompressedColumn
+{
+public:
+    Codec codec() const override
+    {
+        return RUN_LENGTH;
+    }
+
+    size_t size() const override
+    {
+        return _ends.empty() ? 0 : _ends.back();
+    }
+
+    size_t memory_bytes() const override
+    {
+        size_t bytes = sizeof(*this) + _ends.capacity() * sizeof(size_t);
+        for (const string& value : _values) {
+            bytes += string_bytes(value);
+        }
+        return bytes;
+    }
+
+    void decode(size_t begin, size_t end, vector<string>& values) const override
+    {
+        for (size_t run = first_run(begin); begin < end; run++) {
+            size_t run_end = min(end, _ends[run]);
+            values.insert(values.end(), run_end - begin, _values[run]);
+            begin = run_end;
+        }
+    }
+
+    // Each run is compared once.
+    void filter(size_t begin,
+                size_t end,
+                const string& lo,
+                const string& hi,
+                vector<char>& selected) const override
+    {
+        size_t offset = begin;
+        for (size_t run = first_run(begin); begin < end; run++) {
+            size_t run_end = min(end, _ends[run]);
+            if (!in_range(_values[run], lo, hi)) {
+                fill(selected.begin() + (begin - offset), selected.begin() + (run_end - offset), 0);
+            }
+            begin = run_end;
+        }
+    }
+
+    RunLengthColumn(const RowList& rows, unsigned position)
+    {
+        for (size_t i = 0; i < rows.size(); i++) {
+            const string& value = rows[i]->at(position);
+            if (_values.empty() || _values.back() != value) {
+                _values.push_back(value);
+                _ends.push_back(i + 1);
+            } else {
+                _ends.back() = i + 1;
+            }
+        }
+        _values.shrink_to_fit();
+        _ends.shrink_to_fit();
+    }
+
+    // The memory that a RunLengthColumn of the values would take, without building it
+    static size_t estimate(const RowList& rows, unsigned position)
+    {
+        size_t bytes = sizeof(RunLengthColumn);
+        for (size_t i = 0; i < rows.size(); i++) {
+            const string& value = rows[i]->at(position);
+            if (i == 0 || rows[i - 1]->at(position) != value) {
+                bytes += string_bytes(value) + sizeof(size_t);
+            }
+        }
+        return bytes;
+    }
+
+private:
+    size_t first_run(size_t begin) const
+    {
+        return upper_bound(_ends.begin(), _ends.end(), begin) - _ends.begin();
+    }
+
+private:
+    vector<string> _values;
+    vector<size_t> _ends;   // _ends[r] is the position following run r
+};
+
+//----------------------------------------------------------------------
+
+// DELTA
+
+class DeltaColumn : public CompressedColumn
+{
+public:
+    Codec codec() const override
+    {
+        return DELTA;
+    }
+
+    size_t size() const override
+    {
+        return _size;
+    }
+
+    size_t memory_bytes() const override
+    {
+        return sizeof(*this) + _blocks.capacity() * sizeof(Block) + _offsets.memory_bytes() - sizeof(BitPacker);
+    }
+
+    void decode(size_t begin, size_t end, vector<string>& values) const override
+    {
+        scan(begin, end, [&](size_t, int64_t value) {
+            values.push_back(to_string(value));
+        });
+    }
+
+    // Bounds that are integers of the column's width are compared as integers, without decoding to strings.
+    void filter(size_t begin,
+                size_t end,
+                const string& lo,
+                const string& hi,
+                vector<char>& selected) const override
+    {
+        int64_t lo_value;
+        int64_t hi_value;
+        if (!parse(lo, lo_value) || !parse(hi, hi_value)) {
+            CompressedColumn::filter(begin, end, lo, hi, selected);
+            return;
+        }
+        scan(begin, end, [&](size_t i, int64_t value) {
+            if (value < lo_value || value > hi_value) {
+                selected[i - begin] = 0;
+            }
+        });
+    }
+
+    // Returns NULL unless all values are decimal integers with the same number of digits, (so that their string
+    // order is their numeric order), and no leading zeros.
+    static DeltaColumn* create(const RowList& rows, unsigned position)
+    {
+        if (rows.empty()) {
+            return NULL;
+        }
+        DeltaColumn* column = new DeltaColumn(rows.at(0)->at(position).size());
+        vector<int64_t> values;
+        values.reserve(rows.size());
+        for (const Row* row : rows) {
+            int64_t value;
+            if (!column->parse(row->at(position), value)) {
+                delete column;
+                return NULL;
+            }
+            values.push_back(value);
+        }
+        column->encode(values);
+        return column;
+    }
+
+private:
+    struct Block
+    {
+        int64_t first;          // The block's first value
+        int64_t min_delta;      // The smallest difference between consecutive values of the block
+        size_t bit;             // Where the block's offsets (delta - min_delta) start in _offsets
+        unsigned width;         // Bits per offset
+    };
+
+    template <typename Visit>
+    void scan(size_t begin, size_t end, Visit visit) const
+    {
+        for (size_t b = begin / DELTA_BLOCK; b * DELTA_BLOCK < end; b++) {
+            const Block& block = _blocks[b];
+            size_t start = b * DELTA_BLOCK;
+            size_t stop = min(end, start + DELTA_BLOCK);
+            int64_t value = block.first;
+            size_t bit = block.bit;
+            for (size_t i = start; i < stop; i++) {
+                if (i > start) {
+                    value += block.min_delta + (int64_t) _offsets.at(bit, block.width);
+                    bit += block.width;
+                }
+                if (i >= begin) {
+                    visit(i, value);
+                }
+            }
+        }
+    }
+
+    bool parse(const string& text, int64_t& value) const
+    {
+        if (text.size() != _digits || (text[0] == '0' && text.size() > 1)) {
+            return false;
+        }
+        value = 0;
+        for (char c : text) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            value = value * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    void encode(const vector<int64_t>& values)
+    {
+        _size = values.size();
+        for (size_t start = 0; start < _size; start += DELTA_BLOCK) {
+            size_t stop = min(_size, start + DELTA_BLOCK);
+            Block block{values[start], 0, _offsets.bits(), 0};
+            if (stop - start > 1) {
+                int64_t min_delta = values[start + 1] - values[start];
+                int64_t max_delta = min_delta;
+                for (size_t i = start + 2; i < stop; i++) {
+                    min_delta = min(min_delta, values[i] - values[i - 1]);
+                    max_delta = max(max_delta, values[i] - values[i - 1]);
+                }
+                block.min_delta = min_delta;
+                block.width = bit_width((uint64_t) (max_delta - min_delta));
+                for (size_t i = start + 1; i < stop; i++) {
+                    _offsets.append((uint64_t) (values[i] - values[i - 1] - min_delta), block.width);
+                }
+            }
+            _blocks.push_back(block);
+        }
+        _blocks.shrink_to_fit();
+        _offsets.shrink();
+    }
+
+    explicit DeltaColumn(size_t digits)
+        : _digits(digits),
+          _size(0)
+    {
+        if (_digits == 0 || _digits > DELTA_MAX_DIGITS) {
+            _digits = SIZE_MAX;  // Nothing parses
+        }
+    }
+
+private:
+    size_t _digits;
+    size_t _size;
+    vector<Block> _blocks;
+    BitPacker _offsets;
+};
+
+//----------------------------------------------------------------------
+
+// DICTIONARY
+
+class DictionaryColumn : public CompressedColumn
+{
+public:
+    Codec codec() const override
+    {
+        return DICTIONARY;
+    }
+
+    size_t size() const override
+    {
+        return _size;
+    }
+
+    size_t memory_bytes() const override
+    {
+        size_t bytes = sizeof(*this) + _codes.memory_bytes() - sizeof(BitPacker);
+        for (const string& value : _dictionary) {
+            bytes += string_bytes(value);
+        }
+        return bytes;
+    }
+
+    void decode(size_t begin, size_t end, vector<string>& values) const override
+    {
+        for (size_t i = begin; i < end; i++) {
+            values.push_back(_dictionary[code(i)]);
+        }
+    }
+
+    // The dictionary is sorted, so the values in [lo, hi] are those with codes in a range.
+    void filter(size_t begin,
+                size_t end,
+                const string& lo,
+                const string& hi,
+                vector<char>& selected) const override
+    {
+        uint64_t lo_code = lower_bound(_dictionary.begin(), _dictionary.end(), lo) - _dictionary.begin();
+        uint64_t hi_code = upper_bound(_dictionary.begin(), _dictionary.end(), hi) - _dictionary.begin();
+        for (size_t i = begin; i < end; i++) {
+            uint64_t c = code(i);
+            if (c < lo_code || c >= hi_code) {
+                selected[i - begin] = 0;
+            }
+        }
+    }
+
+    DictionaryColumn(const RowList& rows, unsigned position)
+        : _size(rows.size())
+    {
+        _dictionary = distinct(rows, position);
+        _width = bit_width(_dictionary.empty() ? 0 : _dictionary.size() - 1);
+        for (const Row* row : rows) {
+            const string& value = row->at(position);
+            _codes.append(lower_bound(_dictionary.begin(), _dictionary.end(), value) - _dictionary.begin(), _width);
+        }
+        _codes.shrink();
+    }
+
+    static size_t estimate(const RowList& rows, unsigned position)
+    {
+        vector<string> dictionary = distinct(rows, position);
+        size_t bytes = sizeof(DictionaryColumn);
+        for (const string& value : dictionary) {
+            bytes += string_bytes(value);
+        }
+        size_t width = bit_width(dictionary.empty() ? 0 : dictionary.size() - 1);
+        return bytes + (rows.size() * width + 63) / 64 * sizeof(uint64_t);
+    }
+
+private:
+    uint64_t code(size_t i) const
+    {
+        return _codes.at(i * _width, _width);
+    }
+
+    static vector<string> distinct(const RowList& rows, unsigned position)
+    {
+        vector<string> values;
+        values.reserve(rows.size());
+        for (const Row* row : rows) {
+            values.push_back(row->at(position));
+        }
+        sort(values.begin(), values.end());
+        values.erase(unique(values.begin(), values.end()), values.end());
+        values.shrink_to_fit();
+        return values;
+    }
+
+private:
+    size_t _size;
+    vector<string> _dictionary;
+    BitPacker _codes;
+    unsigned _width;
+};
+
+//----------------------------------------------------------------------
+
+CompressedColumn* CompressedColumn::compress(const RowList& rows, unsigned position, Codec codec)
+{
+    switch (codec) {
+        case PLAIN:
+            return new PlainColumn(rows, position);
+        case RUN_LENGTH:
+            return new RunLengthColumn(rows, position);
+        case DELTA:
+            return DeltaColumn::create(rows, position);
+        case DICTIONARY:
+            return new DictionaryColumn(rows, position);
+    }
+    return NULL;
+}
+
+CompressedColumn* CompressedColumn::compress(const RowList& rows, unsigned position)
+{
+    // RUN_LENGTH and DICTIONARY are estimated without building them. DELTA has to be built to find out whether it
+    // applies, and is kept if it is the smallest.
+    size_t run_length = RunLengthColumn::estimate(rows, position);
+    size_t dictionary = DictionaryColumn::estimate(rows, position);
+    CompressedColumn* delta = DeltaColumn::create(rows, position);
+    if (delta != NULL) {
+        if (delta->memory_bytes() <= min(run_length, dictionary)) {
+            return delta;
+        }
+        delete delta;
+    }
+    return run_length <= dictionary
+           ? compress(rows, position, RUN_LENGTH)
+           : compress(rows, position, DICTIONARY);
+}
+
+//----------------------------------------------------------------------
+
+// CompressedTable
+
+const string& CompressedTable::name() const
+{
+    return _name;
+}
+
+const ColumnNames& CompressedTable::columns() const
+{
+    return _columns;
+}
+
+size_t CompressedTable::n_rows() const
+{
+    return _n_rows;
+}
+
+const CompressedColumn* CompressedTable::column(unsigned position) const
+{
+    return _compressed.at(position);
+}
+
+size_t CompressedTable::memory_bytes() const
+{
+    size_t bytes = sizeof(*this);
+    for (const CompressedColumn* column : _compressed) {
+        bytes += column->memory_bytes();
+    }
+    return bytes;
+}
+
+CompressedTable::CompressedTable(Table* table)
+    : _name(table->name()),
+      _columns(table->columns()),
+      _n_rows(table->n_rows()),
+      _compressed(table->columns().size(), NULL)
+{
+    // The rows of a paged table are read back once, and shared by the columns.
+    RowList paged_rows;
+    for (size_t i = 0; table->paged() && i < _n_rows; i++) {
+        paged_rows.emplace_back(table->row(i));
+    }
+    const RowList& rows = table->paged() ? paged_rows : table->rows();
+    parallel_for(0, _columns.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; c++) {
+            _compressed[c] = CompressedColumn::compress(rows, (unsigned) c);
+        }
+    });
+    for (Row* row : paged_rows) {
+        Row::reclaim(row);
+    }
+}
+
+CompressedTable::~CompressedTable()
+{
+    for (CompressedColumn* column : _compressed) {
+        delete column;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <vector>
+#include "ColumnNames.h"
+#include "Row.h"
+
+using namespace std;
+
+class Table;
+
+// One column of a CompressedTable. Values are addressed by row position.
+class CompressedColumn
+{
+public:
+    enum Codec
+    {
+        PLAIN,          // The strings themselves
+        RUN_LENGTH,     // One copy of each run of equal values, and the position where the run ends
+        DELTA,          // For columns of same-width decimal integers: differences between consecutive values, in
+                        // blocks, each stored as an offset from the block's smallest difference, using the fewest
+                        // bits that hold the block's largest offset
+        DICTIONARY      // The distinct values, sorted, and for each row, the (bit-packed) position of its value
+    };
+
+    virtual Codec codec() const = 0;
+
+    // The number of values
+    virtual size_t size() const = 0;
+
+    // The (approximate) number of bytes of memory used by this column
+    virtual size_t memory_bytes() const = 0;
+
+    // Append values [begin, end) to values.
+    virtual void decode(size_t begin, size_t end, vector<string>& values) const = 0;
+
+    // For each position i in [begin, end) for which selected[i - begin] is set, clear it unless lo <= value i <= hi.
+    // Codecs evaluate this on the compressed data where they can, (e.g., once per run, or by comparing dictionary
+    // codes). This default implementation decodes the values.
+    virtual void filter(size_t begin, size_t end, const string& lo, const string& hi, vector<char>& selected) const;
+
+    virtual ~CompressedColumn() {}
+
+public:
+    // Compress the values at the given position of the rows, using whichever codec takes the least memory.
+    static CompressedColumn* compress(const RowList& rows, unsigned position);
+
+    // Compress with the given codec. Returns NULL if the codec can't represent the values, (only DELTA is that
+    // picky).
+    static CompressedColumn* compress(const RowList& rows, unsigned position, Codec codec);
+};
+
+// A read-only, compressed, columnar copy of a Table. Once compressed, the Table can be deleted, and the data queried
+// with compressed_scan.
+class CompressedTable
+{
+public:
+    const string& name() const;
+
+    const ColumnNames& columns() const;
+
+    size_t n_rows() const;
+
+    const CompressedColumn* column(unsigned position) const;
+
+    // The (approximate) number of bytes of memory used by all columns
+    size_t memory_bytes() const;
+
+    // Compress the columns of table, in parallel.
+    explicit CompressedTable(Table* table);
+
+    ~CompressedTable();
+
+    CompressedTable(const CompressedTable&) = delete;
+    CompressedTable& operator=(const CompressedTable&) = delete;
+
+private:
+    string _name;
+    ColumnNames _columns;
+    size_t _n_rows;
+    vector<CompressedColumn*> _compressed;
+};
+
+// The approximate memory used by a string: the object, and the heap allocation, if any.
+size_t string_bytes(const string& s);
+
+#endif //COMPRESSION_H
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "Csv.h"
+#include "MappedFile.h"
+#include "Table.h"
+#include "Row.h"
+#include "Scheduler.h"
+#include "dbexceptions.h"
+
+void parse_csv_line(const char* p, const char* end, Row* row)
+{
+    while (true) {
+        if (p < end && *p == '"') {
+            const char* start = ++p;
+            const char* quote = (const char*) memchr(p, '"', end - p);
+            if (quote == NULL) {
+                throw TableException("Unterminated quoted CSV field");
+            }
+            if (quote + 1 < end && quote[1] == '"') {
+                // Slow path: the field contains escaped quotes.
+                string field;
+                while (quote != NULL && quote + 1 < end && quote[1] == '"') {
+                    field.append(p, quote + 1 - p);
+                    p = quote + 2;
+                    quote = (const char*) memchr(p, '"', end - p);
+                }
+                if (quote == NULL) {
+                    throw TableException("Unterminated quoted CSV field");
+                }
+                field.append(p, quote - p);
+                row->emplace_back(move(field));
+            } else {
+                row->emplace_back(start, quote - start);
+            }
+            p = quote + 1;
+            while (p < end && *p != ',') {
+                p++;
+            }
+        } else {
+            const char* comma = (const char*) memchr(p, ',', end - p);
+            const char* field_end = comma == NULL ? end : comma;
+            row->emplace_back(p, field_end - p);
+            p = field_end;
+        }
+        if (p < end) {
+            p++; // Skip the comma
+        } else {
+            return;
+        }
+    }
+}
+
+// Parse the complete lines in [p, end) into rows of table, appended to rows.
+static void parse_lines(Table* table, const char* p, const char* end, RowList& rows)
+{
+    size_t n_columns = table->columns().size();
+    while (p < end) {
+        const char* newline = (const char*) memchr(p, '\n', end - p);
+        const char* line_end = newline == NULL ? end : newline;
+        const char* next_line = newline == NULL ? end : newline + 1;
+        while (line_end > p && line_end[-1] == '\r') {
+            line_end--;
+        }
+        if (line_end > p) {
+            Row* row = new Row(table);
+            rows.emplace_back(row);
+            row->reserve(n_columns);
+            parse_csv_line(p, line_end, row);
+            if (row->size() != n_columns) {
+                throw TableException("Wrong number of fields in CSV line");
+            }
+        }
+        p = next_line;
+    }
+}
+
+// The position of the first line that starts at or after position, (the end of the buffer if there is none).
+static size_t line_start(const char* data, size_t size, size_t position)
+{
+    if (position == 0 || position >= size) {
+        return min(position, size);
+    }
+    const char* newline = (const char*) memchr(data + position - 1, '\n', size - position + 1);
+    return newline == NULL ? size : newline + 1 - data;
+}
+
+unsigned long load_csv(Table* table, const string& path, size_t range_bytes)
+{
+    // Fields are parsed directly out of the mapping, and copied once, into the strings of the table's rows.
+    MappedFile file(path);
+    const char* data = file.data();
+    size_t size = file.size();
+    if (range_bytes == 0) {
+        range_bytes = 1;
+    }
+    size_t n_ranges = (size + range_bytes - 1) / range_bytes;
+    vector<RowList> batches(n_ranges);
+    try {
+        parallel_for(0, n_ranges, 1, [&](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; i++) {
+                // Range i contains the lines starting in [i * range_bytes, (i + 1) * range_bytes).
+                size_t start = line_start(data, size, i * range_bytes);
+                size_t end = line_start(data, size, min(size, (i + 1) * range_bytes));
+                parse_lines(table, data + start, data + end, batches.at(i));
+            }
+        });
+        RowList rows;
+        size_t n_rows = 0;
+        for (const RowList& batch : batches) {
+            n_rows += batch.size();
+        }
+        rows.reserve(n_rows);
+        for (const RowList& batch : batches) {
+            rows.insert(rows.end(), batch.begin(), batch.end());
+        }
+        table->add_all(rows);
+        return rows.size();
+    } catch (...) {
+        for (RowList& batch : batches) {
+            for (Row* row : batch) {
+                delete row;
+            }
+        }
+        throw;
+    }
+}
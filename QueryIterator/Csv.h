@@ -0,0 +1,30 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <string>
+
+using namespace std;
+
+class Table;
+class Row;
+
+/*
+ * Append the rows of the CSV file at path to table, in file order. Fields may be quoted, (as in the .csv files in db/),
+ * with "" standing for a quote inside a quoted field. Quoted fields must not contain line breaks. Blank lines are
+ * skipped.
+ *
+ * The file is memory-mapped, and split into ranges of about range_bytes, aligned to line boundaries, which are
+ * parsed in parallel on the shared Scheduler. Each field is copied just once, from the mapping into its row. The
+ * rows are then added to the table in one batch. Returns the number of rows loaded.
+ * Throws TableException, (and loads nothing), if the file can't be read, or if a line doesn't have one field per
+ * column of the table.
+ */
+unsigned long load_csv(Table* table, const string& path, size_t range_bytes = 1 << 20);
+
+/*
+ * Append the fields of the CSV line [p, end), (which excludes the line terminator), to row. Throws TableException
+ * if a quoted field is not terminated.
+ */
+void parse_csv_line(const char* p, const char* end, Row* row);
+
+#endif //CSV_H
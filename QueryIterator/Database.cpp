@@ -1,23 +1,119 @@
 #include <sstream>
+#include <algorithm>
+#include <sys/stat.h>
 #include "Database.h"
 
 unordered_map<string, Table*> Database::_tables;
+WriteAheadLog* Database::_log = NULL;
+string Database::_snapshot_path;
 
-Table* Database::new_table(const string &name, const ColumnNames &columns)
+static bool file_exists(const string& path)
+{
+    struct stat file_stat;
+    return stat(path.c_str(), &file_stat) == 0;
+}
+
+Table* Database::new_table(const string &name, const ColumnNames &columns, BufferPool* pool)
 {
     if (_tables.find(name) != _tables.end()) {
         throw TableException("Table name already in use");
     }
-    auto table = new Table(name, columns);
+    auto table = new Table(name, columns, pool);
+    if (_log != NULL) {
+        try {
+            _log->log_new_table(name, columns, pool != NULL);
+        } catch (TableException& e) {
+            delete table;
+            throw;
+        }
+        table->log_to(_log);
+    }
     _tables.insert({{name, table}});
     return table;
 }
 
+Table* Database::table(const string &name)
+{
+    auto i = _tables.find(name);
+    return i == _tables.end() ? NULL : i->second;
+}
+
+vector<Table*> Database::tables()
+{
+    vector<Table*> tables;
+    for (auto& entry : _tables) {
+        tables.emplace_back(entry.second);
+    }
+    sort(tables.begin(), tables.end(), [](Table* x, Table* y) { return x->name() < y->name(); });
+    return tables;
+}
+
 void Database::delete_all()
 {
+    close();
     auto i = _tables.begin();
     while (i != _tables.end()) {
         delete i++->second;
     }
     _tables.clear();
 }
+
+void Database::open(const string& snapshot_path, const string& log_path, BufferPool* pool)
+{
+    if (_log != NULL || !_tables.empty()) {
+        throw TableException("Database is not empty");
+    }
+    uint64_t sequence = 0;
+    size_t valid_bytes = 0;
+    try {
+        if (file_exists(snapshot_path)) {
+            load_snapshot(snapshot_path, &sequence, pool);
+        }
+        if (file_exists(log_path)) {
+            valid_bytes = WriteAheadLog::replay(log_path, sequence, pool);
+        }
+    } catch (TableException& e) {
+        delete_all();
+        throw;
+    }
+    _log = new WriteAheadLog(log_path, sequence, valid_bytes);
+    _snapshot_path = snapshot_path;
+    for (auto& entry : _tables) {
+        entry.second->log_to(_log);
+    }
+}
+
+void Database::sync()
+{
+    if (_log != NULL) {
+        _log->sync();
+    }
+}
+
+void Database::checkpoint()
+{
+    if (_log == NULL) {
+        throw TableException("Database is not logging");
+    }
+    // If a crash follows the snapshot, the old log is recognized as older than the snapshot, and ignored.
+    uint64_t sequence = _log->sequence() + 1;
+    save_snapshot(tables(), _snapshot_path, sequence);
+    string log_path = _log->path();
+    close();
+    _log = new WriteAheadLog(log_path, sequence);
+    for (auto& entry : _tables) {
+        entry.second->log_to(_log);
+    }
+}
+
+void Database::close()
+{
+    if (_log != NULL) {
+        for (auto& entry : _tables) {
+            entry.second->log_to(NULL);
+        }
+        // The destructor writes and fsyncs everything appended.
+        delete _log;
+        _log = NULL;
+    }
+}
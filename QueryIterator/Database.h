@@ -9,6 +9,10 @@
 #include "ColumnNames.h"
 #include "ColumnSelector.h"
 #include "QueryProcessor.h"
+#include "Csv.h"
+#include "ResultWriter.h"
+#include "Snapshot.h"
+#include "WriteAheadLog.h"
 #include "dbexceptions.h"
 
 class Iterator;
@@ -16,14 +20,41 @@ class Iterator;
 class Database
 {
 public:
-    // Returns a new, empty table, with the given name, and column names.
-    static Table* new_table(const string &name, const ColumnNames &columns);
+    // Returns a new, empty table, with the given name, and column names. If pool is not NULL, the table's rows are
+    // stored in pages of that pool, (which must outlive the table).
+    static Table* new_table(const string &name, const ColumnNames &columns, BufferPool* pool = NULL);
 
-    // Delete all tables and rows, resulting an an empty database.
+    // Returns the table with the given name, or NULL if there is no such table.
+    static Table* table(const string &name);
+
+    // Returns all tables, ordered by name.
+    static vector<Table*> tables();
+
+    // Delete all tables and rows, resulting an an empty database. Stops logging, (as by close()), first.
     static void delete_all();
 
+    // Durability: without a log, all data lives only in memory.
+
+    // Recover the database from the snapshot at snapshot_path, (if that file exists), and then the log at log_path,
+    // (if that file exists), and then log all further changes (new tables and added rows) to log_path. The
+    // database must be empty, and not already logging. Tables that were paged are recreated in pool's pages, (pool
+    // must outlive them), or in memory if pool is NULL. Throws TableException if recovery fails.
+    static void open(const string& snapshot_path, const string& log_path, BufferPool* pool = NULL);
+
+    // Wait until all changes logged so far are durable. Changes are made durable in the background, a group of
+    // them per fsync, so this is only needed where a caller must know that they have reached the disk.
+    static void sync();
+
+    // Save a snapshot of all tables, and start an empty log. Recovery then starts from the new snapshot.
+    static void checkpoint();
+
+    // Make all logged changes durable, and stop logging. The tables remain.
+    static void close();
+
 private:
     static unordered_map<string, Table*> _tables;
+    static WriteAheadLog* _log;
+    static string _snapshot_path;
 };
 
 
@@ -1,16 +1,73 @@
 #include "Table.h"
 #include "Index.h"
+#include "BinaryFormat.h"
+
+bool RowRef::operator==(const RowRef& other) const
+{
+    return row != NULL || other.row != NULL ? row == other.row : position == other.position;
+}
 
 void Index::put(const vector<string>& key, Row* value)
+{
+    put(key, RowRef{value, UINT64_MAX});
+}
+
+void Index::put(const vector<string>& key, const RowRef& value)
 {
     insert(make_pair(key, value));
 }
 
+void Index::put_sorted(vector<Entry>& entries)
+{
+    for (Entry& entry : entries) {
+        // As with put, the first of several entries with equal keys wins.
+        emplace_hint(end(), move(entry.first), entry.second);
+    }
+}
+
 unsigned Index::n_columns()
 {
     return _n_columns;
 }
 
-Index::Index(Table* table)
-    : _n_columns((unsigned) table->columns().size())
+Table* Index::table() const
+{
+    return _table;
+}
+
+const ColumnNames& Index::key_columns() const
+{
+    return _key_columns;
+}
+
+void Index::save(const string& path) const
+{
+    BinaryWriter writer(path);
+    writer.bytes(INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC));
+    writer.u32(INDEX_FILE_VERSION);
+    writer.u32(BYTE_ORDER_MARK);
+    writer.str(_table->name());
+    writer.u64(_table_version);
+    writer.u64(_table_rows);
+    writer.u32((uint32_t) _key_columns.size());
+    for (const string& column : _key_columns) {
+        writer.str(column);
+    }
+    // If the table has changed since this index was built, its current key values don't describe the index. The
+    // file is then stale anyway, (by version), so the fingerprint is left out.
+    bool current = _table->version() == _table_version;
+    writer.u64(current ? _table->key_fingerprint(_key_columns) : 0);
+    writer.u64(size());
+    for (const value_type& entry : *this) {
+        writer.u64(entry.second.position);
+    }
+    writer.commit();
+}
+
+Index::Index(Table* table, const ColumnNames& key_columns)
+    : _table(table),
+      _key_columns(key_columns),
+      _n_columns((unsigned) table->columns().size()),
+      _table_version(table->version()),
+      _table_rows(table->n_rows())
 {}
@@ -1,8 +1,11 @@
 #ifndef INDEX_H
 #define INDEX_H
 
+#include <cstdint>
 #include <map>
+#include <string>
 #include <vector>
+#include "ColumnNames.h"
 
 using namespace std;
 
@@ -10,15 +13,56 @@ class Row;
 
 class Table;
 
-class Index: public map<vector<string>, Row*>
+// Refers to a row of a table by its position, and for a table held in memory, also by the Row itself. (Rows of a
+// paged table are read through the buffer pool, by position.)
+struct RowRef
+{
+    Row* row;
+    uint64_t position;
+
+    // Refers to the same row
+    bool operator==(const RowRef& other) const;
+};
+
+class Index: public map<vector<string>, RowRef>
 {
 public:
+    typedef pair<vector<string>, RowRef> Entry;
+
+    // Add an entry for a row of a table held in memory, whose position isn't needed, (i.e., an index that won't
+    // be saved).
     void put(const vector<string>& key, Row* value);
+
+    void put(const vector<string>& key, const RowRef& value);
+
+    // Add entries that are sorted by key, (and for equal keys, in the order in which put would have been called).
+    // The tree is built by appending at its right edge, which takes amortized constant time per entry. The keys
+    // are moved out of entries.
+    void put_sorted(vector<Entry>& entries);
+
     unsigned n_columns();
-    Index(Table* table);
+
+    // The table whose rows this index refers to
+    Table* table() const;
+
+    // The columns forming the key, in key order
+    const ColumnNames& key_columns() const;
+
+    // Write this index to path, replacing any existing file. The file refers to rows by their positions in the
+    // table, and records the version of the table that the index was built from, and a fingerprint of its key
+    // values. (An index is not updated by later changes to the table, so if there have been any, the file records
+    // the older version, and Table::open_index will find it stale.) Throws TableException on I/O errors. See
+    // Table::open_index.
+    void save(const string& path) const;
+
+    Index(Table* table, const ColumnNames& key_columns);
 
 private:
+    Table* _table;
+    ColumnNames _key_columns;
     unsigned _n_columns;
+    unsigned long _table_version;           // The table's version and size when this index was built
+    uint64_t _table_rows;
 };
 
 #endif //INDEX_H
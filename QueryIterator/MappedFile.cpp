@@ -0,0 +1,50 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MappedFile.h"
+#include "dbexceptions.h"
+
+const char* MappedFile::data() const
+{
+    return _data;
+}
+
+size_t MappedFile::size() const
+{
+    return _size;
+}
+
+MappedFile::MappedFile(const string& path)
+    : _data(NULL),
+      _size(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw TableException("Can't open " + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw TableException("Can't stat " + path);
+    }
+    _size = (size_t) file_stat.st_size;
+    if (_size > 0) {
+        void* mapping = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw TableException("Can't map " + path);
+        }
+        madvise(mapping, _size, MADV_SEQUENTIAL);
+        _data = (const char*) mapping;
+    }
+    // The mapping stays valid after the file is closed.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data != NULL) {
+        munmap((void*) _data, _size);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+
+using namespace std;
+
+// A read-only memory mapping of an entire file.
+class MappedFile
+{
+public:
+    // The first byte of the file. NULL if the file is empty.
+    const char* data() const;
+
+    // The size of the file, in bytes.
+    size_t size() const;
+
+    // Map the file at path. Throws TableException if the file can't be opened or mapped.
+    explicit MappedFile(const string& path);
+
+    // Unmap the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    const char* _data;
+    size_t _size;
+};
+
+#endif //MAPPEDFILE_H
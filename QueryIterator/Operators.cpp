@@ -1,5 +1,8 @@
 #include <cassert>
+#include <cstring>
 #include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
 #include "QueryProcessor.h"
 #include "Table.h"
 #include "Index.h"
@@ -9,6 +12,8 @@
 #include "Operators.h"
 #include "util.h"
 #include "RowCompare.h"
+#include "Csv.h"
+#include "dbexceptions.h"
 
 //----------------------------------------------------------------------
 
@@ -21,27 +26,27 @@ unsigned TableIterator::n_columns()
 
 void TableIterator::open() 
 {
-	_end = _table->rows().end();
-	_input = _table->rows().begin();
+	_end = _table->n_rows();
+	_position = 0;
 }
 
 Row* TableIterator::next() 
 {
-	if (_input != _end) {
-		_input++;
-		return *(_input - 1);
-	}
+	if (_position != _end)
+		return _table->row(_position++);
 	else
 		return NULL;
 }
 
 void TableIterator::close() 
 {
-	_input = _end;
+	_position = _end;
 }
 
 TableIterator::TableIterator(Table* table)
-    : _table(table)
+    : _table(table),
+      _position(0),
+      _end(0)
 {
 }
 
@@ -63,9 +68,9 @@ void IndexScan::open()
 Row* IndexScan::next()
 {
 	if (_input != _end) {
-		Row* row = _input->second;
+		const RowRef& ref = _input->second;
 		_input++;
-		return row;
+		return ref.row != NULL ? ref.row : _index->table()->row(ref.position);
 	}
 	else
 		return NULL;
@@ -124,6 +129,56 @@ Select::~Select()
 
 //----------------------------------------------------------------------
 
+// RangeSelect
+
+static bool in_ranges(const Row* row, const vector<ColumnRange>& ranges)
+{
+	for (const ColumnRange& range : ranges) {
+		const string& value = row->at(range.column);
+		if (value < range.lo || value > range.hi) {
+			return false;
+		}
+	}
+	return true;
+}
+
+unsigned RangeSelect::n_columns()
+{
+	return _input->n_columns();
+}
+
+void RangeSelect::open()
+{
+	_input->open();
+}
+
+Row* RangeSelect::next()
+{
+	Row* next = _input->next();
+	while (next != NULL && !in_ranges(next, _ranges)) {
+		Row::reclaim(next);
+		next = _input->next();
+	}
+	return next;
+}
+
+void RangeSelect::close()
+{
+	_input->close();
+}
+
+RangeSelect::RangeSelect(Iterator* input, const vector<ColumnRange>& ranges)
+    : _input(input),
+      _ranges(ranges)
+{}
+
+RangeSelect::~RangeSelect()
+{
+    delete _input;
+}
+
+//----------------------------------------------------------------------
+
 // Project
 
 unsigned Project::n_columns()
@@ -155,7 +210,7 @@ void Project::close()
     _input->close();
 }
 
-Project::Project(Iterator* input, const initializer_list<unsigned>& columns)
+Project::Project(Iterator* input, const vector<unsigned>& columns)
     : _input(input),
       _column_selector(input->n_columns(), columns)
 {}
@@ -179,7 +234,6 @@ void NestedLoopsJoin::open()
 	_left->open();
 	_right->open();
 	_left_row = _left->next();
-	joinResult = new Row();
 }
 
 Row* NestedLoopsJoin::next()
@@ -192,6 +246,7 @@ Row* NestedLoopsJoin::next()
 		Row* _right_row = _right->next();
 
 		if (_right_row == NULL) {       // The row in r (first table) has joined with every row in s (second table)
+			Row::reclaim(_left_row);
 			_left_row = _left->next();  
 			if (_left_row == NULL) {    // We have joined all rows in two tables
 				Row::reclaim(_right_row);
@@ -217,11 +272,14 @@ Row* NestedLoopsJoin::next()
 			if (_left_row->at(_left_join_columns.selected(i)) != _right_row->at(_right_join_columns.selected(i)))
 				isEqual = false;
 		if (isEqual) {
-			*joinResult = *_left_row;
+			// Each result is a new intermediate row, owned by the caller, so that a consumer
+			// (e.g. a PipelineBreak on another thread) can hold it while the join moves on.
+			Row* joined = new Row();
+			joined->insert(joined->end(), _left_row->begin(), _left_row->end());
 			for (unsigned i = 0; i < _right_join_columns.n_unselected(); i++)
-				joinResult->append(_right_row->at(_right_join_columns.unselected(i)));
+				joined->append(_right_row->at(_right_join_columns.unselected(i)));
 			Row::reclaim(_right_row);
-			return joinResult;
+			return joined;
 		}
 		else
 			Row::reclaim(_right_row);
@@ -232,13 +290,14 @@ void NestedLoopsJoin::close()
 {
 	_left->close();
 	_right->close();
-	delete joinResult;
+	Row::reclaim(_left_row);
+	_left_row = NULL;
 }
 
 NestedLoopsJoin::NestedLoopsJoin(Iterator* left,
-	const initializer_list<unsigned>& left_join_columns,
+	const vector<unsigned>& left_join_columns,
 	Iterator* right,
-	const initializer_list<unsigned>& right_join_columns)
+	const vector<unsigned>& right_join_columns)
 	: _left(left),
 	_right(right),
 	_left_join_columns(left->n_columns(), left_join_columns),
@@ -362,3 +421,649 @@ Unique::~Unique()
 {
     delete _input;
 }
+
+//----------------------------------------------------------------------
+
+// PipelineBreak
+
+// The number of times each thread retries the queue, yielding in between, before waiting to be signalled
+static const unsigned PIPELINE_SPINS = 64;
+
+unsigned PipelineBreak::n_columns()
+{
+	return _input->n_columns();
+}
+
+void PipelineBreak::open()
+{
+	// Reopening without a close stops the previous producer first, (assigning to a joinable thread terminates).
+	stop_producer();
+	_cancelled = false;
+	_error = nullptr;
+	_batch = NULL;
+	_batch_position = 0;
+	_done = false;
+	_producer = thread(&PipelineBreak::produce, this);
+}
+
+Row* PipelineBreak::next()
+{
+	while (!_done) {
+		if (_batch != NULL && _batch_position < _batch->size()) {
+			return _batch->at(_batch_position++);
+		}
+		delete _batch;
+		_batch = NULL;
+		_batch_position = 0;
+		for (unsigned spins = 0; !_queue.pop(_batch); spins++) {
+			if (spins < PIPELINE_SPINS) {
+				this_thread::yield();
+			} else {
+				unique_lock<mutex> lock(_signal_lock);
+				_queue_changed.wait(lock, [this] { return _queue.pop(_batch); });
+				break;
+			}
+		}
+		signal();                       // There is room for the producer
+		if (_batch == NULL) {           // The producer is done, possibly because the input failed
+			_done = true;
+			_producer.join();
+			if (_error) {
+				exception_ptr error = _error;
+				_error = nullptr;
+				rethrow_exception(error);
+			}
+		}
+	}
+	return NULL;
+}
+
+void PipelineBreak::close()
+{
+	stop_producer();
+}
+
+// Runs on the producer thread: drains the input in batches, and ends the stream with a NULL batch.
+void PipelineBreak::produce()
+{
+	RowList* batch = NULL;
+	bool opened = false;
+	try {
+		_input->open();
+		opened = true;
+		Row* row;
+		while (!_cancelled && (row = _input->next()) != NULL) {
+			if (batch == NULL) {
+				batch = new RowList();
+				batch->reserve(_batch_size);
+			}
+			batch->emplace_back(row);
+			if (batch->size() == _batch_size) {
+				RowList* full = batch;
+				batch = NULL;
+				if (!hand_off(full)) {
+					break;
+				}
+			}
+		}
+		if (batch != NULL) {
+			RowList* partial = batch;
+			batch = NULL;
+			hand_off(partial);
+		}
+		opened = false;
+		_input->close();
+	} catch (...) {
+		if (batch != NULL) {
+			for (Row* row : *batch) {
+				Row::reclaim(row);
+			}
+			delete batch;
+		}
+		_error = current_exception();
+		if (opened) {
+			try {
+				_input->close();
+			} catch (...) {
+				// The first error is the one reported.
+			}
+		}
+	}
+	hand_off(NULL);
+}
+
+// Waits for room in the queue (backpressure), giving up if the consumer has closed this iterator.
+// Returns true if the batch was handed to the consumer.
+bool PipelineBreak::hand_off(RowList* batch)
+{
+	bool handed_off = _queue.push(batch);
+	for (unsigned spins = 0; !handed_off && !_cancelled; spins++) {
+		if (spins < PIPELINE_SPINS) {
+			this_thread::yield();
+			handed_off = _queue.push(batch);
+		} else {
+			unique_lock<mutex> lock(_signal_lock);
+			_queue_changed.wait(lock, [&] { return (handed_off = _queue.push(batch)) || _cancelled; });
+		}
+	}
+	if (!handed_off) {
+		if (batch != NULL) {
+			for (Row* row : *batch) {
+				Row::reclaim(row);
+			}
+			delete batch;
+		}
+		return false;
+	}
+	signal();                           // There is a batch for the consumer
+	return true;
+}
+
+// Wakes the other thread if it is waiting on _queue_changed. Taking _signal_lock orders this with a thread that has
+// just found the queue full or empty and is about to wait, so the notification isn't lost.
+void PipelineBreak::signal()
+{
+	{
+		lock_guard<mutex> lock(_signal_lock);
+	}
+	_queue_changed.notify_all();
+}
+
+void PipelineBreak::stop_producer()
+{
+	if (_producer.joinable()) {
+		_cancelled = true;
+		signal();
+		_producer.join();
+	}
+	// Reclaim whatever the consumer didn't get to.
+	if (_batch != NULL) {
+		for (unsigned i = _batch_position; i < _batch->size(); i++) {
+			Row::reclaim(_batch->at(i));
+		}
+		delete _batch;
+		_batch = NULL;
+	}
+	RowList* batch;
+	while (_queue.pop(batch)) {
+		if (batch != NULL) {
+			for (Row* row : *batch) {
+				Row::reclaim(row);
+			}
+			delete batch;
+		}
+	}
+	_done = true;
+}
+
+PipelineBreak::PipelineBreak(Iterator* input, unsigned batch_size)
+    : _input(input),
+      _batch_size(batch_size == 0 ? 1 : batch_size),
+      _queue(16),
+      _cancelled(false),
+      _batch(NULL),
+      _batch_position(0),
+      _done(true)
+{}
+
+PipelineBreak::~PipelineBreak()
+{
+    stop_producer();
+    delete _input;
+}
+
+//----------------------------------------------------------------------
+
+// CsvScan
+
+unsigned CsvScan::n_columns()
+{
+	return (unsigned) _schema.size();
+}
+
+void CsvScan::open()
+{
+	close();
+	_fd = ::open(_path.c_str(), O_RDONLY);
+	if (_fd < 0) {
+		throw TableException("Can't open " + _path);
+	}
+	_start = 0;
+	_end = 0;
+	_eof = false;
+}
+
+Row* CsvScan::next()
+{
+	while (_fd >= 0) {
+		const char* data = _buffer.data();
+		const char* newline = (const char*) memchr(data + _start, '\n', _end - _start);
+		if (newline == NULL && !_eof) {
+			refill();
+			continue;
+		}
+		if (newline == NULL && _start == _end) {
+			return NULL;
+		}
+		// A complete line, or the last line of a file that doesn't end with a newline.
+		const char* line = data + _start;
+		const char* line_end = newline == NULL ? data + _end : newline;
+		_start = newline == NULL ? _end : newline + 1 - data;
+		while (line_end > line && line_end[-1] == '\r') {
+			line_end--;
+		}
+		if (line_end > line) {
+			Row* row = new Row();
+			row->reserve(_schema.size());
+			try {
+				parse_csv_line(line, line_end, row);
+				if (row->size() != _schema.size()) {
+					throw TableException("Wrong number of fields in CSV line");
+				}
+			} catch (TableException& e) {
+				delete row;
+				throw;
+			}
+			return row;
+		}
+	}
+	return NULL;
+}
+
+void CsvScan::close()
+{
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+}
+
+// Read more input, after moving unparsed input to the start of the buffer, (growing the buffer if a line
+// doesn't fit).
+void CsvScan::refill()
+{
+	size_t unparsed = _end - _start;
+	memmove(_buffer.data(), _buffer.data() + _start, unparsed);
+	_start = 0;
+	_end = unparsed;
+	if (_end == _buffer.size()) {
+		_buffer.resize(_buffer.size() * 2);
+	}
+	ssize_t n_read = read(_fd, _buffer.data() + _end, _buffer.size() - _end);
+	if (n_read < 0) {
+		throw TableException("Can't read " + _path);
+	}
+	_end += n_read;
+	_eof = n_read == 0;
+}
+
+CsvScan::CsvScan(const string& path, const ColumnNames& schema, size_t buffer_size)
+    : _path(path),
+      _schema(schema),
+      _fd(-1),
+      _buffer(buffer_size == 0 ? 1 : buffer_size),
+      _start(0),
+      _end(0),
+      _eof(true)
+{}
+
+CsvScan::~CsvScan()
+{
+    close();
+}
+
+//----------------------------------------------------------------------
+
+// CompressedScan
+
+// Rows per block. Predicates are evaluated, and columns decoded, a block at a time.
+static const size_t COMPRESSED_SCAN_BLOCK = 1024;
+
+unsigned CompressedScan::n_columns()
+{
+	return (unsigned) _table->columns().size();
+}
+
+void CompressedScan::open()
+{
+	_block_start = 0;
+	_block_end = 0;
+	_position = 0;
+	_selected.clear();
+}
+
+Row* CompressedScan::next()
+{
+	while (true) {
+		while (_position < _selected.size() && !_selected[_position]) {
+			_position++;
+		}
+		if (_position < _selected.size()) {
+			Row* row = new Row();
+			row->reserve(_values.size());
+			for (vector<string>& column : _values) {
+				row->emplace_back(move(column[_position]));
+			}
+			_position++;
+			return row;
+		}
+		if (_block_end == _table->n_rows()) {
+			return NULL;
+		}
+		next_block();
+	}
+}
+
+void CompressedScan::close()
+{
+	_block_start = _block_end = _table->n_rows();
+	_selected.clear();
+	_values.clear();
+	_position = 0;
+}
+
+// Evaluate the ranges over the next block, on the compressed columns, and decode the block only if some row
+// passes.
+void CompressedScan::next_block()
+{
+	_block_start = _block_end;
+	_block_end = min(_table->n_rows(), _block_start + COMPRESSED_SCAN_BLOCK);
+	_selected.assign(_block_end - _block_start, 1);
+	for (const ColumnRange& range : _ranges) {
+		_table->column(range.column)->filter(_block_start, _block_end, range.lo, range.hi, _selected);
+	}
+	_position = 0;
+	_values.resize(_table->columns().size());
+	for (vector<string>& column : _values) {
+		column.clear();
+	}
+	if (find(_selected.begin(), _selected.end(), 1) != _selected.end()) {
+		for (unsigned c = 0; c < _values.size(); c++) {
+			_table->column(c)->decode(_block_start, _block_end, _values[c]);
+		}
+	} else {
+		_selected.clear();
+	}
+}
+
+CompressedScan::CompressedScan(const CompressedTable* table, const vector<ColumnRange>& ranges)
+    : _table(table),
+      _ranges(ranges),
+      _block_start(0),
+      _block_end(0),
+      _position(0)
+{
+	for (const ColumnRange& range : _ranges) {
+		assert(range.column < _table->columns().size());
+	}
+}
+
+//----------------------------------------------------------------------
+
+// ZoneScan
+
+unsigned ZoneScan::n_columns()
+{
+	return (unsigned) _table->columns().size();
+}
+
+void ZoneScan::open()
+{
+	_position = 0;
+	_zone_end = 0;
+	_end = _table->n_rows();
+	_zones_scanned = 0;
+}
+
+Row* ZoneScan::next()
+{
+	const vector<Zone>& zones = _table->zones();
+	while (_position < _end) {
+		if (_position == _zone_end) {
+			// Skip zones that can't contain a qualifying row.
+			size_t zone = _position / Table::ZONE_ROWS;
+			while (zone < zones.size() && zone * Table::ZONE_ROWS < _end && !zone_may_match(zones.at(zone))) {
+				zone++;
+			}
+			_position = min(_end, zone * Table::ZONE_ROWS);
+			_zone_end = min(_end, (zone + 1) * Table::ZONE_ROWS);
+			if (_position == _end) {
+				break;
+			}
+			_zones_scanned++;
+		}
+		Row* row = _table->row(_position++);
+		if (row_matches(row)) {
+			return row;
+		}
+		Row::reclaim(row);
+	}
+	return NULL;
+}
+
+void ZoneScan::close()
+{
+	_position = _end;
+}
+
+unsigned long ZoneScan::zones_scanned() const
+{
+	return _zones_scanned;
+}
+
+bool ZoneScan::zone_may_match(const Zone& zone) const
+{
+	for (const ColumnRange& range : _ranges) {
+		if (zone.max.at(range.column) < range.lo || zone.min.at(range.column) > range.hi) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ZoneScan::row_matches(const Row* row) const
+{
+	return in_ranges(row, _ranges);
+}
+
+ZoneScan::ZoneScan(Table* table, const vector<ColumnRange>& ranges)
+    : _table(table),
+      _ranges(ranges),
+      _position(0),
+      _zone_end(0),
+      _end(0),
+      _zones_scanned(0)
+{
+	for (const ColumnRange& range : _ranges) {
+		assert(range.column < _table->columns().size());
+	}
+}
+
+//----------------------------------------------------------------------
+
+// BloomSelect
+
+unsigned BloomSelect::n_columns()
+{
+	return _input->n_columns();
+}
+
+void BloomSelect::open()
+{
+	_n_input_rows = 0;
+	_n_passed_rows = 0;
+	_input->open();
+}
+
+Row* BloomSelect::next()
+{
+	Row* row;
+	while ((row = _input->next()) != NULL) {
+		_n_input_rows++;
+		if (_filter->may_contain(key_hash(row, *_key_columns))) {
+			_n_passed_rows++;
+			return row;
+		}
+		Row::reclaim(row);
+	}
+	return NULL;
+}
+
+void BloomSelect::close()
+{
+	_input->close();
+}
+
+unsigned long BloomSelect::n_input_rows() const
+{
+	return _n_input_rows;
+}
+
+unsigned long BloomSelect::n_passed_rows() const
+{
+	return _n_passed_rows;
+}
+
+BloomSelect::BloomSelect(Iterator* input, const BloomFilter* filter, const ColumnSelector* key_columns)
+    : _input(input),
+      _filter(filter),
+      _key_columns(key_columns),
+      _n_input_rows(0),
+      _n_passed_rows(0)
+{}
+
+BloomSelect::~BloomSelect()
+{
+	delete _input;
+}
+
+//----------------------------------------------------------------------
+
+// BloomJoin
+
+unsigned BloomJoin::n_columns()
+{
+	return _left->n_columns() + _right_n_columns - _left_join_columns.n_selected();
+}
+
+// Materialize the left input, and build the Bloom filter over its keys. Then scan the right input through the
+// filter, keeping the rows that pass, grouped by key. Most right rows that can't join never get past the filter.
+void BloomJoin::open()
+{
+	release_rows();
+	_left->open();
+	Row* row;
+	while ((row = _left->next()) != NULL) {
+		_build.emplace_back(row);
+	}
+	_left->close();
+	_filter = BloomFilter(_build.size());
+	for (Row* left_row : _build) {
+		_filter.add(key_hash(left_row, _left_join_columns));
+	}
+	if (!_build.empty()) {
+		_right->open();
+		while ((row = _right->next()) != NULL) {
+			_probe.emplace_back(row);
+			vector<string> key;
+			for (unsigned i = 0; i < _right_join_columns.n_selected(); i++) {
+				key.emplace_back(row->at(_right_join_columns.selected(i)));
+			}
+			_probe_by_key[key].emplace_back(row);
+		}
+		_right->close();
+	}
+	_build_position = 0;
+	_matches = NULL;
+	_match_position = 0;
+}
+
+// Joins in the same order as NestedLoopsJoin: for each left row, the matching right rows, in input order.
+Row* BloomJoin::next()
+{
+	while (true) {
+		if (_matches != NULL && _match_position < _matches->size()) {
+			Row* left_row = _build.at(_build_position);
+			Row* right_row = _matches->at(_match_position++);
+			Row* joined = new Row();
+			joined->insert(joined->end(), left_row->begin(), left_row->end());
+			for (unsigned i = 0; i < _right_join_columns.n_unselected(); i++) {
+				joined->append(right_row->at(_right_join_columns.unselected(i)));
+			}
+			return joined;
+		}
+		if (_matches != NULL) {
+			_build_position++;
+		}
+		if (_build_position >= _build.size()) {
+			return NULL;
+		}
+		Row* left_row = _build.at(_build_position);
+		vector<string> key;
+		for (unsigned i = 0; i < _left_join_columns.n_selected(); i++) {
+			key.emplace_back(left_row->at(_left_join_columns.selected(i)));
+		}
+		auto found = _probe_by_key.find(key);
+		if (found == _probe_by_key.end()) {
+			_build_position++;
+			_matches = NULL;
+		} else {
+			_matches = &found->second;
+			_match_position = 0;
+		}
+	}
+}
+
+void BloomJoin::close()
+{
+	release_rows();
+}
+
+unsigned long BloomJoin::n_probe_rows() const
+{
+	return _right->n_input_rows();
+}
+
+unsigned long BloomJoin::n_probe_rows_passed() const
+{
+	return _right->n_passed_rows();
+}
+
+void BloomJoin::release_rows()
+{
+	for (Row* row : _build) {
+		Row::reclaim(row);
+	}
+	for (Row* row : _probe) {
+		Row::reclaim(row);
+	}
+	_build.clear();
+	_probe.clear();
+	_probe_by_key.clear();
+	_build_position = 0;
+	_matches = NULL;
+	_match_position = 0;
+}
+
+BloomJoin::BloomJoin(Iterator* left,
+                     const vector<unsigned>& left_join_columns,
+                     Iterator* right,
+                     const vector<unsigned>& right_join_columns)
+    : _left(left),
+      _right_n_columns(right->n_columns()),
+      _left_join_columns(left->n_columns(), left_join_columns),
+      _right_join_columns(right->n_columns(), right_join_columns),
+      _right(new BloomSelect(right, &_filter, &_right_join_columns)),
+      _build_position(0),
+      _matches(NULL),
+      _match_position(0)
+{
+	assert(_left_join_columns.n_selected() == _right_join_columns.n_selected());
+}
+
+BloomJoin::~BloomJoin()
+{
+	release_rows();
+	delete _left;
+	delete _right;
+}
@@ -1,12 +1,23 @@
 #ifndef OPERATORS_H
 #define OPERATORS_H
 
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <map>
 #include "Iterator.h"
 #include "Index.h"
 #include "Row.h"
 #include "ColumnSelector.h"
+#include "ColumnNames.h"
+#include "SpscQueue.h"
+#include "Compression.h"
+#include "BloomFilter.h"
 
 class Table;
+struct Zone;
 class Row;
 
 class TableIterator : public Iterator {
@@ -21,8 +32,8 @@ public:
 
 private:
     Table* _table;
-    RowList::iterator _end;
-    RowList::iterator _input;
+    size_t _position;
+    size_t _end;
 };
 
 class Select : public Iterator {
@@ -41,6 +52,23 @@ private:
     RowPredicate _predicate;
 };
 
+// Passes the rows of its input satisfying every one of the column ranges
+class RangeSelect : public Iterator {
+public:
+    unsigned n_columns() override;
+    void open() override;
+    Row* next() override;
+    void close() override;
+
+public:
+    RangeSelect(Iterator* input, const vector<ColumnRange>& ranges);
+    ~RangeSelect();
+
+private:
+    Iterator* _input;
+    vector<ColumnRange> _ranges;
+};
+
 class Project : public Iterator {
 public:
     unsigned n_columns() override;
@@ -49,7 +77,7 @@ public:
     void close() override;
 
 public:
-    Project(Iterator* input, const initializer_list<unsigned>& columns);
+    Project(Iterator* input, const vector<unsigned>& columns);
     ~Project();
 
 private:
@@ -70,9 +98,9 @@ private:
 
 public:
     NestedLoopsJoin(Iterator* left,
-                    const initializer_list<unsigned>& left_join_columns,
+                    const vector<unsigned>& left_join_columns,
                     Iterator* right,
-                    const initializer_list<unsigned>& right_join_columns);
+                    const vector<unsigned>& right_join_columns);
     ~NestedLoopsJoin();
 
 private:
@@ -81,8 +109,6 @@ private:
     ColumnSelector _left_join_columns;
     ColumnSelector _right_join_columns;
     Row* _left_row;
-
-	Row* joinResult;
 };
 
 class IndexScan: public Iterator
@@ -140,4 +166,175 @@ private:
     Row* _last_unique;
 };
 
+class PipelineBreak: public Iterator
+{
+public:
+    unsigned n_columns() override;
+    void open() override;
+    Row* next() override;
+    void close() override;
+
+private:
+    void produce();
+    bool hand_off(RowList* batch);
+    void signal();
+    void stop_producer();
+
+public:
+    PipelineBreak(Iterator* input, unsigned batch_size);
+    ~PipelineBreak();
+
+private:
+    Iterator* _input;
+    unsigned _batch_size;
+    SpscQueue<RowList*> _queue;
+    thread _producer;
+    atomic<bool> _cancelled;
+    mutex _signal_lock;
+    condition_variable _queue_changed;      // Signalled when a batch is pushed or popped, or on cancellation
+    exception_ptr _error;
+    RowList* _batch;
+    unsigned _batch_position;
+    bool _done;
+};
+
+class CsvScan: public Iterator
+{
+public:
+    unsigned n_columns() override;
+    void open() override;
+    Row* next() override;
+    void close() override;
+
+private:
+    void refill();
+
+public:
+    CsvScan(const string& path, const ColumnNames& schema, size_t buffer_size);
+    ~CsvScan();
+
+private:
+    string _path;
+    ColumnNames _schema;
+    int _fd;
+    vector<char> _buffer;
+    size_t _start;          // Unparsed input is _buffer[_start, _end)
+    size_t _end;
+    bool _eof;
+};
+
+class CompressedScan: public Iterator
+{
+public:
+    unsigned n_columns() override;
+    void open() override;
+    Row* next() override;
+    void close() override;
+
+private:
+    void next_block();
+
+public:
+    CompressedScan(const CompressedTable* table, const vector<ColumnRange>& ranges);
+
+private:
+    const CompressedTable* _table;
+    vector<ColumnRange> _ranges;
+    size_t _block_start;            // The current block is [_block_start, _block_end)
+    size_t _block_end;
+    vector<char> _selected;         // Whether each row of the block satisfies all ranges
+    vector<vector<string>> _values; // Decoded values of the block, by column, (empty if no row is selected)
+    size_t _position;               // Next row of the block to consider, relative to _block_start
+};
+
+class ZoneScan: public Iterator
+{
+public:
+    unsigned n_columns() override;
+    void open() override;
+    Row* next() override;
+    void close() override;
+
+    // The number of zones whose rows were examined by the last scan
+    unsigned long zones_scanned() const;
+
+private:
+    bool zone_may_match(const Zone& zone) const;
+    bool row_matches(const Row* row) const;
+
+public:
+    ZoneScan(Table* table, const vector<ColumnRange>& ranges);
+
+private:
+    Table* _table;
+    vector<ColumnRange> _ranges;
+    size_t _position;               // The next row to examine
+    size_t _zone_end;               // The end of the zone containing _position, (0 before the first zone)
+    size_t _end;                    // The number of rows when the scan was opened
+    unsigned long _zones_scanned;
+};
+
+// Passes the rows of its input whose key may be in a Bloom filter, (owned by the caller, and possibly replaced
+// between scans), discarding the others.
+class BloomSelect: public Iterator
+{
+public:
+    unsigned n_columns() override;
+    void open() override;
+    Row* next() override;
+    void close() override;
+
+    // Rows read from the input, and rows passed, since the last open
+    unsigned long n_input_rows() const;
+    unsigned long n_passed_rows() const;
+
+public:
+    BloomSelect(Iterator* input, const BloomFilter* filter, const ColumnSelector* key_columns);
+    ~BloomSelect();
+
+private:
+    Iterator* _input;
+    const BloomFilter* _filter;
+    const ColumnSelector* _key_columns;
+    unsigned long _n_input_rows;
+    unsigned long _n_passed_rows;
+};
+
+class BloomJoin: public Iterator
+{
+public:
+    unsigned n_columns() override;
+    void open() override;
+    Row* next() override;
+    void close() override;
+
+    // The number of probe-side rows read, and the number that got past the Bloom filter, in the last scan
+    unsigned long n_probe_rows() const;
+    unsigned long n_probe_rows_passed() const;
+
+private:
+    void release_rows();
+
+public:
+    BloomJoin(Iterator* left,
+              const vector<unsigned>& left_join_columns,
+              Iterator* right,
+              const vector<unsigned>& right_join_columns);
+    ~BloomJoin();
+
+private:
+    Iterator* _left;
+    unsigned _right_n_columns;
+    ColumnSelector _left_join_columns;
+    ColumnSelector _right_join_columns;
+    BloomFilter _filter;
+    BloomSelect* _right;                    // The right input, behind the Bloom filter
+    vector<Row*> _build;                    // The left rows
+    vector<Row*> _probe;                    // The right rows that passed the filter
+    map<vector<string>, vector<Row*>> _probe_by_key;
+    size_t _build_position;                 // The current left row
+    const vector<Row*>* _matches;           // Right rows matching the current left row
+    size_t _match_position;                 // The next of those to join
+};
+
 #endif //OPERATORS_H
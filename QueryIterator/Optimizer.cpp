@@ -0,0 +1,581 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include "Optimizer.h"
+#include "Index.h"
+#include "Iterator.h"
+#include "QueryProcessor.h"
+#include "Statistics.h"
+#include "Table.h"
+#include "dbexceptions.h"
+
+typedef LogicalPlan::Column Column;
+typedef LogicalPlan::Relation Relation;
+
+// Selectivities guessed for conditions that can't be estimated from an index or statistics
+static const double EQUALITY_SELECTIVITY = 0.1;
+static const double RANGE_SELECTIVITY = 0.3;
+
+// The cost per row of building and probing the tables of a Bloom join, relative to reading a row
+static const double HASH_COST = 2;
+
+static const unsigned MAX_RELATIONS = 12;
+
+//----------------------------------------------------------------------
+
+// LogicalPlan
+
+void LogicalPlan::scan(Table* table, const string& alias)
+{
+    for (const Relation& relation : _relations) {
+        if (relation.alias == alias) {
+            throw TableException("Alias " + alias + " is already in use");
+        }
+    }
+    _relations.push_back(Relation{table, alias, {}, {}, {}});
+}
+
+void LogicalPlan::where(const string& column, const string& value)
+{
+    where(column, value, value);
+}
+
+void LogicalPlan::where(const string& column, const string& lo, const string& hi)
+{
+    Column c = this->column(column);
+    _relations.at(c.relation).ranges.push_back(ColumnRange{c.column, lo, hi});
+}
+
+void LogicalPlan::where(const string& alias, RowPredicate predicate, double selectivity)
+{
+    Relation& r = _relations.at(relation(alias));
+    r.predicates.push_back(predicate);
+    r.selectivities.push_back(min(1.0, max(0.0, selectivity)));
+}
+
+void LogicalPlan::join(const string& column, const string& other_column)
+{
+    Column c = this->column(column);
+    Column other = this->column(other_column);
+    if (c.relation == other.relation) {
+        throw TableException("Can't join " + column + " to a column of the same alias");
+    }
+    _joins.emplace_back(c, other);
+}
+
+void LogicalPlan::project(const ColumnNames& columns)
+{
+    _result.clear();
+    for (const string& name : columns) {
+        _result.push_back(column(name));
+    }
+}
+
+const vector<Relation>& LogicalPlan::relations() const
+{
+    return _relations;
+}
+
+const vector<pair<Column, Column>>& LogicalPlan::joins() const
+{
+    return _joins;
+}
+
+vector<Column> LogicalPlan::result() const
+{
+    if (!_result.empty()) {
+        return _result;
+    }
+    vector<Column> all;
+    for (unsigned r = 0; r < _relations.size(); r++) {
+        for (unsigned c = 0; c < _relations.at(r).table->columns().size(); c++) {
+            all.push_back(Column{r, c});
+        }
+    }
+    return all;
+}
+
+LogicalPlan::LogicalPlan()
+{}
+
+Column LogicalPlan::column(const string& name) const
+{
+    size_t dot = name.find('.');
+    if (dot == string::npos) {
+        throw TableException("Column " + name + " has no alias");
+    }
+    unsigned r = relation(name.substr(0, dot));
+    int c = _relations.at(r).table->columns().position(name.substr(dot + 1));
+    if (c < 0) {
+        throw TableException("Unknown column " + name);
+    }
+    return Column{r, (unsigned) c};
+}
+
+unsigned LogicalPlan::relation(const string& alias) const
+{
+    for (unsigned r = 0; r < _relations.size(); r++) {
+        if (_relations.at(r).alias == alias) {
+            return r;
+        }
+    }
+    throw TableException("Unknown alias " + alias);
+}
+
+//----------------------------------------------------------------------
+
+// Estimates
+
+// The number of entries of the index with keys in [lo, hi], counting at most limit of them
+static double index_rows(const Index* index, const vector<string>& lo, const vector<string>& hi, double limit)
+{
+    if (hi < lo) {
+        return 0;
+    }
+    double n = 0;
+    for (auto i = index->lower_bound(lo), end = index->upper_bound(hi); i != end && n < limit; i++) {
+        n++;
+    }
+    return n;
+}
+
+// True if the index has an entry for every row of its table. (An index has one entry per key, so it can stand
+// in for a scan only if its keys are unique, and it has been kept up to date.)
+static bool covers_table(const Index* index)
+{
+    return index->size() == index->table()->n_rows();
+}
+
+// The index of table whose only key column is column, or NULL if there is none that covers the table
+static const Index* column_index(const Table* table, unsigned column)
+{
+    for (const Index* index : table->indexes()) {
+        if (index->key_columns().size() == 1 &&
+            table->columns().position(index->key_columns().at(0)) == (int) column &&
+            covers_table(index)) {
+            return index;
+        }
+    }
+    return NULL;
+}
+
+static double range_selectivity(const Table* table, const ColumnRange& range)
+{
+    double n = (double) table->n_rows();
+    const Index* index = column_index(table, range.column);
+    if (index != NULL && n > 0) {
+        return index_rows(index, {range.lo}, {range.hi}, n) / n;
+    }
+    if (table->statistics() != NULL) {
+        return table->statistics()->column(range.column).selectivity(range.lo, range.hi);
+    }
+    return range.lo == range.hi ? EQUALITY_SELECTIVITY : RANGE_SELECTIVITY;
+}
+
+// The number of rows of the zones that a zone scan for the ranges would examine
+static double zone_scan_rows(const Table* table, const vector<ColumnRange>& ranges)
+{
+    size_t n = table->n_rows();
+    size_t zone_rows = Table::ZONE_ROWS;
+    if (ranges.empty()) {
+        return (double) n;
+    }
+    double rows = 0;
+    const vector<Zone>& zones = table->zones();
+    for (size_t z = 0; z < zones.size(); z++) {
+        bool may_match = true;
+        for (const ColumnRange& range : ranges) {
+            may_match = may_match &&
+                        !(zones.at(z).max.at(range.column) < range.lo || zones.at(z).min.at(range.column) > range.hi);
+        }
+        if (may_match) {
+            rows += (double) min(zone_rows, n - z * zone_rows);
+        }
+    }
+    return rows;
+}
+
+//----------------------------------------------------------------------
+
+// Optimizer
+
+// The root of an optimized plan, owning the keys of its index scans, (which IndexScan only refers to).
+class OptimizedPlan : public Iterator
+{
+public:
+    unsigned n_columns() override
+    {
+        return _plan->n_columns();
+    }
+
+    void open() override
+    {
+        _plan->open();
+    }
+
+    Row* next() override
+    {
+        return _plan->next();
+    }
+
+    void close() override
+    {
+        _plan->close();
+    }
+
+    OptimizedPlan(Iterator* plan, const vector<Row*>& keys)
+        : _plan(plan),
+          _keys(keys)
+    {}
+
+    ~OptimizedPlan()
+    {
+        delete _plan;
+        for (Row* key : _keys) {
+            delete key;
+        }
+    }
+
+private:
+    Iterator* _plan;
+    vector<Row*> _keys;
+};
+
+class Optimizer
+{
+public:
+    Iterator* optimize(string* explanation)
+    {
+        unsigned n = (unsigned) _plan.relations().size();
+        if (n == 0) {
+            throw TableException("The plan has no tables");
+        }
+        if (n > MAX_RELATIONS) {
+            throw TableException("Too many tables to optimize");
+        }
+        find_classes();
+        _best.assign(1u << n, -1);
+        for (unsigned r = 0; r < n; r++) {
+            _best[1u << r] = access(r);
+        }
+        for (unsigned set = 1; set < (1u << n); set++) {
+            if (_best[set] == -1) {
+                _best[set] = best_join(set);
+            }
+        }
+        int root = _best[(1u << n) - 1];
+        vector<unsigned> positions;
+        for (const Column& column : _plan.result()) {
+            positions.push_back(position(_nodes.at(root), column));
+        }
+        vector<Row*> keys;
+        string text;
+        Iterator* plan = project(build(root, keys, text), positions);
+        if (explanation != NULL) {
+            *explanation = "project(" + text + ")";
+        }
+        return new OptimizedPlan(plan, keys);
+    }
+
+    explicit Optimizer(const LogicalPlan& plan)
+        : _plan(plan)
+    {}
+
+private:
+    // A physical plan: an access path for one relation, or a join of two plans
+    struct Node
+    {
+        double cost;
+        double rows;
+        // For each position of the plan's rows, the columns of the relations that have its value there, (several
+        // columns, once they have been joined).
+        vector<vector<Column>> schema;
+        // An access path
+        int relation;                   // -1 for a join
+        const Index* index;             // NULL for a table or zone scan
+        vector<string> lo;              // The keys scanned by the index
+        vector<string> hi;
+        vector<ColumnRange> ranges;     // The ranges checked by the scan, or by a select following the index scan
+        // A join
+        int left;
+        int right;
+        bool bloom;
+        vector<unsigned> left_columns;
+        vector<unsigned> right_columns;
+    };
+
+    // Group the joined columns into classes of columns with equal values, (e.g. a.x = b.y and b.y = c.z).
+    void find_classes()
+    {
+        vector<unsigned> parent;
+        auto id = [&](const Column& column) {
+            auto found = _class.find(key(column));
+            if (found != _class.end()) {
+                return found->second;
+            }
+            unsigned i = (unsigned) parent.size();
+            parent.push_back(i);
+            _class[key(column)] = i;
+            return i;
+        };
+        function<unsigned(unsigned)> root = [&](unsigned i) {
+            return parent[i] == i ? i : parent[i] = root(parent[i]);
+        };
+        for (const pair<Column, Column>& join : _plan.joins()) {
+            parent[root(id(join.first))] = root(id(join.second));
+        }
+        map<unsigned, vector<unsigned>> relations;
+        for (auto& entry : _class) {
+            entry.second = root(entry.second);
+            vector<unsigned>& class_relations = relations[entry.second];
+            unsigned relation = (unsigned) (entry.first >> 32);
+            if (find(class_relations.begin(), class_relations.end(), relation) != class_relations.end()) {
+                throw TableException("Columns of alias " + _plan.relations().at(relation).alias +
+                                     " are joined to each other");
+            }
+            class_relations.push_back(relation);
+        }
+    }
+
+    static uint64_t key(const Column& column)
+    {
+        return (uint64_t) column.relation << 32 | column.column;
+    }
+
+    // The class of the column, or -1 if it isn't joined
+    int column_class(const Column& column) const
+    {
+        auto found = _class.find(key(column));
+        return found == _class.end() ? -1 : (int) found->second;
+    }
+
+    // The cheapest access path for a relation
+    int access(unsigned r)
+    {
+        const Relation& relation = _plan.relations().at(r);
+        const Table* table = relation.table;
+        double n = (double) table->n_rows();
+        Node node;
+        node.relation = (int) r;
+        node.left = node.right = -1;
+        node.bloom = false;
+        for (unsigned c = 0; c < table->columns().size(); c++) {
+            node.schema.push_back({Column{r, c}});
+        }
+        // Ranges on the same column are intersected.
+        map<unsigned, ColumnRange> ranges;
+        for (const ColumnRange& range : relation.ranges) {
+            auto found = ranges.find(range.column);
+            if (found == ranges.end()) {
+                ranges[range.column] = range;
+            } else {
+                found->second.lo = max(found->second.lo, range.lo);
+                found->second.hi = min(found->second.hi, range.hi);
+            }
+        }
+        node.rows = n;
+        for (auto& entry : ranges) {
+            node.ranges.push_back(entry.second);
+            node.rows *= range_selectivity(table, entry.second);
+        }
+        for (double selectivity : relation.selectivities) {
+            node.rows *= selectivity;
+        }
+        node.index = NULL;
+        node.cost = zone_scan_rows(table, node.ranges);
+        for (const Index* index : table->indexes()) {
+            if (!covers_table(index)) {
+                continue;
+            }
+            // A single column key can be scanned for a range. Longer keys need an equality for each column.
+            vector<string> lo;
+            vector<string> hi;
+            vector<unsigned> key_columns;
+            for (const string& name : index->key_columns()) {
+                auto found = ranges.find((unsigned) table->columns().position(name));
+                if (found == ranges.end() ||
+                    (index->key_columns().size() > 1 && found->second.lo != found->second.hi)) {
+                    break;
+                }
+                lo.push_back(found->second.lo);
+                hi.push_back(found->second.hi);
+                key_columns.push_back(found->first);
+            }
+            if (key_columns.size() < index->key_columns().size()) {
+                continue;
+            }
+            double cost = log2(n + 1) + index_rows(index, lo, hi, n);
+            if (cost < node.cost) {
+                node.cost = cost;
+                node.index = index;
+                node.lo = lo;
+                node.hi = hi;
+                node.ranges.clear();
+                for (auto& entry : ranges) {
+                    if (find(key_columns.begin(), key_columns.end(), entry.first) == key_columns.end()) {
+                        node.ranges.push_back(entry.second);
+                    }
+                }
+            }
+        }
+        _nodes.push_back(node);
+        return (int) _nodes.size() - 1;
+    }
+
+    // The pairs of positions, of the left and right plans, with columns of the same class
+    void join_columns(const Node& left, const Node& right,
+                      vector<unsigned>& left_columns, vector<unsigned>& right_columns) const
+    {
+        map<int, unsigned> left_positions;
+        for (unsigned p = 0; p < left.schema.size(); p++) {
+            int c = column_class(left.schema.at(p).at(0));
+            if (c != -1) {
+                left_positions[c] = p;
+            }
+        }
+        for (unsigned p = 0; p < right.schema.size(); p++) {
+            auto found = left_positions.find(column_class(right.schema.at(p).at(0)));
+            if (found != left_positions.end()) {
+                left_columns.push_back(found->second);
+                right_columns.push_back(p);
+            }
+        }
+    }
+
+    // An estimate of the number of distinct values at a position of a plan's rows, from the statistics of the
+    // columns there, (or assuming that a column is a key of its table, if the table hasn't been analyzed).
+    double distinct(const Node& node, unsigned position) const
+    {
+        double n = node.rows;
+        for (const Column& column : node.schema.at(position)) {
+            const Table* table = _plan.relations().at(column.relation).table;
+            const TableStatistics* statistics = table->statistics();
+            n = min(n, statistics != NULL
+                       ? statistics->column(column.column).n_distinct()
+                       : (double) table->n_rows());
+        }
+        return max(n, 1.0);
+    }
+
+    // The cheapest join of two plans for subsets that partition set
+    int best_join(unsigned set)
+    {
+        Node best;
+        best.cost = HUGE_VAL;
+        for (unsigned left_set = (set - 1) & set; left_set != 0; left_set = (left_set - 1) & set) {
+            const Node& left = _nodes.at(_best[left_set]);
+            const Node& right = _nodes.at(_best[set ^ left_set]);
+            vector<unsigned> left_columns;
+            vector<unsigned> right_columns;
+            join_columns(left, right, left_columns, right_columns);
+            double rows = left.rows * right.rows;
+            for (unsigned i = 0; i < left_columns.size(); i++) {
+                rows /= max(distinct(left, left_columns[i]), distinct(right, right_columns[i]));
+            }
+            // A nested loops join rescans its right input for each left row.
+            double nested_loops_cost = left.cost + max(left.rows, 1.0) * right.cost;
+            double bloom_cost = left.cost + right.cost + HASH_COST * (left.rows + right.rows);
+            double cost = min(nested_loops_cost, bloom_cost);
+            if (cost < best.cost) {
+                best.cost = cost;
+                best.rows = rows;
+                best.left = _best[left_set];
+                best.right = _best[set ^ left_set];
+                best.bloom = bloom_cost < nested_loops_cost;
+                best.left_columns = left_columns;
+                best.right_columns = right_columns;
+            }
+        }
+        // The output has the columns of the left input, followed by the right input's columns that aren't joined.
+        const Node& left = _nodes.at(best.left);
+        const Node& right = _nodes.at(best.right);
+        best.relation = -1;
+        best.index = NULL;
+        best.schema = left.schema;
+        for (unsigned p = 0; p < right.schema.size(); p++) {
+            auto joined = find(best.right_columns.begin(), best.right_columns.end(), p);
+            if (joined == best.right_columns.end()) {
+                best.schema.push_back(right.schema.at(p));
+            } else {
+                vector<Column>& columns = best.schema.at(best.left_columns.at(joined - best.right_columns.begin()));
+                columns.insert(columns.end(), right.schema.at(p).begin(), right.schema.at(p).end());
+            }
+        }
+        _nodes.push_back(best);
+        return (int) _nodes.size() - 1;
+    }
+
+    unsigned position(const Node& node, const Column& column) const
+    {
+        for (unsigned p = 0; p < node.schema.size(); p++) {
+            for (const Column& c : node.schema.at(p)) {
+                if (c.relation == column.relation && c.column == column.column) {
+                    return p;
+                }
+            }
+        }
+        throw TableException("Column is missing from the plan");
+    }
+
+    // Create the iterators of a plan, appending the keys of index scans to keys, and describing the plan in text
+    Iterator* build(int n, vector<Row*>& keys, string& text) const
+    {
+        const Node& node = _nodes.at(n);
+        if (node.relation == -1) {
+            string left_text;
+            string right_text;
+            Iterator* left = build(node.left, keys, left_text);
+            Iterator* right = build(node.right, keys, right_text);
+            text = (node.bloom ? "bloom_join(" : "nested_loops_join(") + left_text + ", " + right_text + ")";
+            return node.bloom
+                   ? bloom_join(left, node.left_columns, right, node.right_columns)
+                   : nested_loops_join(left, node.left_columns, right, node.right_columns);
+        }
+        const Relation& relation = _plan.relations().at(node.relation);
+        Iterator* input;
+        if (node.index != NULL) {
+            Row* lo = new Row();
+            Row* hi = new Row();
+            keys.push_back(lo);
+            keys.push_back(hi);
+            for (unsigned i = 0; i < node.lo.size(); i++) {
+                lo->append(node.lo.at(i));
+                hi->append(node.hi.at(i));
+            }
+            input = index_scan(const_cast<Index*>(node.index), lo, hi);
+            text = "index_scan(" + relation.alias + "." + node.index->key_columns().at(0);
+            for (unsigned i = 1; i < node.index->key_columns().size(); i++) {
+                text += "," + node.index->key_columns().at(i);
+            }
+            text += ")";
+            if (!node.ranges.empty()) {
+                input = select(input, node.ranges);
+            }
+        } else if (node.ranges.empty()) {
+            input = table_scan(relation.table);
+            text = "table_scan(" + relation.alias + ")";
+        } else {
+            input = zone_scan(relation.table, node.ranges);
+            text = "zone_scan(" + relation.alias + ")";
+        }
+        for (RowPredicate predicate : relation.predicates) {
+            input = select(input, predicate);
+        }
+        if ((node.index != NULL && !node.ranges.empty()) || !relation.predicates.empty()) {
+            text = "select(" + text + ")";
+        }
+        return input;
+    }
+
+private:
+    const LogicalPlan& _plan;
+    map<uint64_t, unsigned> _class;     // The class of each joined column, (see key)
+    vector<Node> _nodes;
+    vector<int> _best;                  // For each subset of the relations, the cheapest plan found
+};
+
+Iterator* optimize(const LogicalPlan& plan, string* explanation)
+{
+    return Optimizer(plan).optimize(explanation);
+}
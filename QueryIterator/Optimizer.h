@@ -0,0 +1,102 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "Row.h"
+#include "ColumnNames.h"
+
+class Iterator;
+class Table;
+
+using namespace std;
+
+/*
+ * A query, stated logically: the tables it reads, (each under an alias, so that a table can be read more than
+ * once), conditions on their columns, equi-joins between them, and the columns of the result. Columns are named
+ * "alias.column". The physical plan, (join order, access paths and join algorithms), is left to optimize. E.g.
+ *
+ *     LogicalPlan plan;
+ *     plan.scan(user, "u");
+ *     plan.scan(routing, "r");
+ *     plan.scan(message, "m");
+ *     plan.where("u.username", "Zyrianyhippy");
+ *     plan.join("u.user_id", "r.from_user_id");
+ *     plan.join("r.message_id", "m.message_id");
+ *     plan.project(ColumnNames{"m.send_date"});
+ *     Iterator* q2 = optimize(plan);
+ *
+ * The methods throw TableException on an unknown alias or column.
+ */
+class LogicalPlan
+{
+public:
+    // A table read by the query, and the conditions on its columns alone
+    struct Relation
+    {
+        Table* table;
+        string alias;
+        vector<ColumnRange> ranges;
+        vector<RowPredicate> predicates;
+        vector<double> selectivities;       // The estimated fraction of rows passing each predicate
+    };
+
+    // A column of one of the relations
+    struct Column
+    {
+        unsigned relation;
+        unsigned column;
+    };
+
+    // Read table under the given alias, which must not be in use.
+    void scan(Table* table, const string& alias);
+
+    // Keep only the rows in which the column's value is value, or between lo and hi, inclusive, (comparing as
+    // strcmp does).
+    void where(const string& column, const string& value);
+    void where(const string& column, const string& lo, const string& hi);
+
+    // Keep only the rows of the alias's table satisfying predicate, (which is called with rows of that table). The
+    // selectivity is the estimated fraction of rows that satisfy it.
+    void where(const string& alias, RowPredicate predicate, double selectivity = 0.5);
+
+    // Keep only the combinations of rows in which the two columns, (of different aliases), have equal values.
+    void join(const string& column, const string& other_column);
+
+    // The columns of the result, in order. By default, the result has every column of every alias, in the order in
+    // which the aliases and their columns were added.
+    void project(const ColumnNames& columns);
+
+    const vector<Relation>& relations() const;
+    const vector<pair<Column, Column>>& joins() const;
+
+    // The columns of the result
+    vector<Column> result() const;
+
+    LogicalPlan();
+
+private:
+    Column column(const string& name) const;
+    unsigned relation(const string& alias) const;
+
+private:
+    vector<Relation> _relations;
+    vector<pair<Column, Column>> _joins;
+    vector<Column> _result;
+};
+
+/*
+ * Return the physical plan for the logical plan that has the lowest estimated cost. Join orders, (including bushy
+ * ones), are enumerated by dynamic programming over the subsets of the relations, keeping the cheapest plan for
+ * each subset, (so there can be at most 12 relations). Each relation is read by an index scan, if one of its
+ * indexes covers its conditions, or by a zone scan, (see zone_scan), and each join is a nested loops join or a
+ * Bloom join, (see bloom_join). The cost of a plan is an estimate of the number of rows it reads, (counting each
+ * rescan of the right input of a nested loops join), based on the sizes of the tables, their zones, the number of
+ * index entries matching each range, and the statistics of tables that have been analyzed, (see analyze).
+ * Selectivities that can't be estimated that way are guessed.
+ *
+ * If explanation is not NULL, it is set to a description of the plan, e.g.
+ * "project(nested_loops_join(index_scan(u.username), table_scan(r)))". The rows of the result are intermediate
+ * rows, and their order depends on the plan.
+ */
+Iterator* optimize(const LogicalPlan& plan, string* explanation = NULL);
+
+#endif //OPTIMIZER_H
@@ -10,11 +10,21 @@ Iterator* select(Iterator* input, RowPredicate predicate)
     return new Select(input, predicate);
 }
 
+Iterator* select(Iterator* input, const vector<ColumnRange>& ranges)
+{
+    return new RangeSelect(input, ranges);
+}
+
 Iterator* project(Iterator* input, initializer_list<unsigned> project_columns)
 {
     return new Project(input, project_columns);
 }
 
+Iterator* project(Iterator* input, const vector<unsigned>& project_columns)
+{
+    return new Project(input, project_columns);
+}
+
 Iterator* nested_loops_join(Iterator* left,
                             const initializer_list<unsigned>& left_columns,
                             Iterator* right,
@@ -23,6 +33,14 @@ Iterator* nested_loops_join(Iterator* left,
     return new NestedLoopsJoin(left, left_columns, right, right_columns);
 }
 
+Iterator* nested_loops_join(Iterator* left,
+                            const vector<unsigned>& left_columns,
+                            Iterator* right,
+                            const vector<unsigned>& right_columns)
+{
+    return new NestedLoopsJoin(left, left_columns, right, right_columns);
+}
+
 Iterator* index_scan(Index* index, Row* lo, Row* hi)
 {
     return new IndexScan(index, lo, hi);
@@ -36,4 +54,40 @@ Iterator* sort(Iterator* input, const initializer_list<unsigned>& sort_columns)
 Iterator* unique(Iterator* input)
 {
     return new Unique(input);
-}
\ No newline at end of file
+}
+
+Iterator* csv_scan(const string& path, const ColumnNames& schema, size_t buffer_size)
+{
+    return new CsvScan(path, schema, buffer_size);
+}
+
+Iterator* pipeline_break(Iterator* input, unsigned batch_size)
+{
+    return new PipelineBreak(input, batch_size);
+}
+
+Iterator* compressed_scan(const CompressedTable* table, const vector<ColumnRange>& ranges)
+{
+    return new CompressedScan(table, ranges);
+}
+
+Iterator* zone_scan(Table* table, const vector<ColumnRange>& ranges)
+{
+    return new ZoneScan(table, ranges);
+}
+
+Iterator* bloom_join(Iterator* left,
+                     const initializer_list<unsigned>& left_columns,
+                     Iterator* right,
+                     const initializer_list<unsigned>& right_columns)
+{
+    return new BloomJoin(left, left_columns, right, right_columns);
+}
+
+Iterator* bloom_join(Iterator* left,
+                     const vector<unsigned>& left_columns,
+                     Iterator* right,
+                     const vector<unsigned>& right_columns)
+{
+    return new BloomJoin(left, left_columns, right, right_columns);
+}
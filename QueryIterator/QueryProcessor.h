@@ -2,10 +2,12 @@
 #define QUERYPROCESSOR_H
 
 #include "Row.h"
+#include "ColumnNames.h"
 
 class Iterator;
 class Table;
 class Index;
+class CompressedTable;
 
 using namespace std;
 
@@ -26,11 +28,17 @@ Iterator* index_scan(Index* index, Row* lo, Row* hi = NULL);
  */
 Iterator* select(Iterator* input, RowPredicate predicate);
 
+/*
+ * Return an iterator including only those input rows that satisfy every one of the column ranges.
+ */
+Iterator* select(Iterator* input, const vector<ColumnRange>& ranges);
+
 /*
  * Return an iterator whose rows contain only the columns specified in project_columns.
  * Duplicates are NOT eliminated.
  */
 Iterator* project(Iterator* input, initializer_list<unsigned> project_columns);
+Iterator* project(Iterator* input, const vector<unsigned>& project_columns);
 
 /*
  * Return an iterator containing the join of rows in left and right. The join columns
@@ -44,6 +52,26 @@ Iterator* nested_loops_join(Iterator* left,
                             const initializer_list<unsigned>& left_columns,
                             Iterator* right,
                             const initializer_list<unsigned>& right_columns);
+Iterator* nested_loops_join(Iterator* left,
+                            const vector<unsigned>& left_columns,
+                            Iterator* right,
+                            const vector<unsigned>& right_columns);
+
+/*
+ * Return an iterator containing the same join as nested_loops_join, (with the same arguments), in the same order.
+ * The left input is read first, in full, and a Bloom filter is built over its join keys. The filter is pushed down
+ * to the right input, so that right rows whose keys aren't in the filter are discarded as they are scanned, without
+ * being kept or compared. The right input is read just once. Use this when few left rows have a match on the right,
+ * (e.g. a selective scan of users joined with all routing rows).
+ */
+Iterator* bloom_join(Iterator* left,
+                     const initializer_list<unsigned>& left_columns,
+                     Iterator* right,
+                     const initializer_list<unsigned>& right_columns);
+Iterator* bloom_join(Iterator* left,
+                     const vector<unsigned>& left_columns,
+                     Iterator* right,
+                     const vector<unsigned>& right_columns);
 
 /*
  * Return an iterator sorting by the columns specified in sort_columns.
@@ -56,4 +84,38 @@ Iterator* sort(Iterator* input, const initializer_list<unsigned>& sort_columns);
  */
 Iterator* unique(Iterator* input);
 
+/*
+ * Return an iterator over the rows of the CSV file at path, (in the format accepted by load_csv), whose columns are
+ * given by schema. Lines are read through a buffer of buffer_size bytes, (which grows if a line doesn't fit), and
+ * parsed as next() is called, so a one-pass query over the file runs in constant memory, without loading a Table.
+ * The rows are intermediate rows. open() throws TableException if the file can't be opened, and next() throws it
+ * if a line doesn't have one field per column of the schema.
+ */
+Iterator* csv_scan(const string& path, const ColumnNames& schema, size_t buffer_size = 1 << 20);
+
+/*
+ * Return an iterator producing the same rows as input, in the same order. The input is run on its own thread,
+ * which hands rows to the caller's thread in batches of batch_size rows, through a bounded lock-free queue.
+ * The input thread stalls when the queue is full, so it never runs far ahead of the consumer. Use this to overlap
+ * the work below the pipeline break (e.g. join probing) with the work above it (e.g. project and sort).
+ */
+Iterator* pipeline_break(Iterator* input, unsigned batch_size = 256);
+
+/*
+ * Return an iterator over the rows of a compressed table that satisfy every one of the column ranges, (all rows if
+ * there are none). Ranges are evaluated on the compressed columns, a block of rows at a time, and only blocks with
+ * at least one qualifying row are decoded. The rows are intermediate rows, in the order of the table that was
+ * compressed.
+ */
+Iterator* compressed_scan(const CompressedTable* table, const vector<ColumnRange>& ranges = vector<ColumnRange>());
+
+/*
+ * Return an iterator over the rows of the table that satisfy every one of the column ranges, in table order.
+ * Zones (see Table::zones) whose min/max values show that none of their rows can satisfy a range are skipped
+ * without examining their rows, so on columns whose values are clustered in table order, (e.g. ids assigned in
+ * order, or dates of appended events), a selective scan reads only a fraction of the table. The rows are those of
+ * the table.
+ */
+Iterator* zone_scan(Table* table, const vector<ColumnRange>& ranges);
+
 #endif //QUERYPROCESSOR_H
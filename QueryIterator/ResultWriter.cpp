@@ -0,0 +1,195 @@
+#include <cstring>
+#include <unistd.h>
+#include "ResultWriter.h"
+#include "Iterator.h"
+#include "Row.h"
+#include "dbexceptions.h"
+
+//----------------------------------------------------------------------
+
+// ResultWriter
+
+void ResultWriter::write_row(const Row* row)
+{
+    char delimiter = _format == CSV ? ',' : '\t';
+    for (size_t i = 0; i < row->size(); i++) {
+        if (i > 0) {
+            append(&delimiter, 1);
+        }
+        append_field(row->at(i));
+    }
+    append("\n", 1);
+}
+
+void ResultWriter::flush()
+{
+    if (_threaded) {
+        hand_off();
+        unique_lock<mutex> lock(_lock);
+        _changed.wait(lock, [this] { return !_has_pending; });
+        check_error();
+    } else {
+        write_all(_buffer.data(), _size);
+        _size = 0;
+    }
+}
+
+void ResultWriter::append(const char* data, size_t n)
+{
+    while (n > 0) {
+        if (_size == _buffer.size()) {
+            if (_threaded) {
+                hand_off();
+            } else {
+                write_all(_buffer.data(), _size);
+                _size = 0;
+            }
+        }
+        size_t k = min(n, _buffer.size() - _size);
+        memcpy(_buffer.data() + _size, data, k);
+        _size += k;
+        data += k;
+        n -= k;
+    }
+}
+
+void ResultWriter::append_field(const string& value)
+{
+    if (_format == TSV) {
+        append(value.data(), value.size());
+        return;
+    }
+    append("\"", 1);
+    const char* p = value.data();
+    const char* end = p + value.size();
+    const char* quote;
+    while ((quote = (const char*) memchr(p, '"', end - p)) != NULL) {
+        append(p, quote + 1 - p);
+        append("\"", 1);
+        p = quote + 1;
+    }
+    append(p, end - p);
+    append("\"", 1);
+}
+
+// Give the buffer to the writer thread, (after it is done with the previous one), and continue with an empty one.
+void ResultWriter::hand_off()
+{
+    unique_lock<mutex> lock(_lock);
+    _changed.wait(lock, [this] { return !_has_pending; });
+    check_error();
+    if (_size > 0) {
+        swap(_buffer, _pending);
+        _pending_size = _size;
+        _has_pending = true;
+        _size = 0;
+        _changed.notify_all();
+    }
+}
+
+void ResultWriter::write_all(const char* data, size_t n)
+{
+    while (n > 0) {
+        ssize_t written = write(_fd, data, n);
+        if (written <= 0) {
+            throw TableException("Can't write results");
+        }
+        data += written;
+        n -= written;
+    }
+}
+
+// The writer thread
+void ResultWriter::write_pending()
+{
+    unique_lock<mutex> lock(_lock);
+    while (true) {
+        _changed.wait(lock, [this] { return _has_pending || _stopping; });
+        if (!_has_pending) {
+            return;
+        }
+        lock.unlock();
+        string error;
+        try {
+            write_all(_pending.data(), _pending_size);
+        } catch (TableException& e) {
+            error = e.what();
+        }
+        lock.lock();
+        if (!error.empty() && _error.empty()) {
+            _error = error;
+        }
+        _has_pending = false;
+        _changed.notify_all();
+    }
+}
+
+// Called with _lock held
+void ResultWriter::check_error()
+{
+    if (!_error.empty()) {
+        string error = _error;
+        _error.clear();
+        throw TableException(error);
+    }
+}
+
+ResultWriter::ResultWriter(int fd, ResultFormat format, size_t buffer_size, bool writer_thread)
+    : _fd(fd),
+      _format(format),
+      _buffer(buffer_size == 0 ? 1 : buffer_size),
+      _size(0),
+      _threaded(writer_thread),
+      _pending(_threaded ? _buffer.size() : 0),
+      _pending_size(0),
+      _has_pending(false),
+      _stopping(false)
+{
+    if (_threaded) {
+        _writer = thread(&ResultWriter::write_pending, this);
+    }
+}
+
+ResultWriter::~ResultWriter()
+{
+    try {
+        flush();
+    } catch (TableException& e) {
+    }
+    if (_threaded) {
+        {
+            lock_guard<mutex> lock(_lock);
+            _stopping = true;
+        }
+        _changed.notify_all();
+        _writer.join();
+    }
+}
+
+//----------------------------------------------------------------------
+
+unsigned long write_iterator(Iterator* input, int fd, ResultFormat format, bool writer_thread, size_t buffer_size)
+{
+    ResultWriter writer(fd, format, buffer_size, writer_thread);
+    unsigned long n_rows = 0;
+    input->open();
+    try {
+        Row* row;
+        while ((row = input->next()) != NULL) {
+            try {
+                writer.write_row(row);
+            } catch (TableException& e) {
+                Row::reclaim(row);
+                throw;
+            }
+            Row::reclaim(row);
+            n_rows++;
+        }
+        writer.flush();
+    } catch (...) {
+        input->close();
+        throw;
+    }
+    input->close();
+    return n_rows;
+}
@@ -0,0 +1,76 @@
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class Iterator;
+class Row;
+
+enum ResultFormat
+{
+    CSV,    // Every field quoted, with "" standing for a quote, (the format accepted by load_csv)
+    TSV     // Fields as they are, separated by tabs
+};
+
+// Formats rows into a large buffer, which is written to a file descriptor when full. With a writer thread, a full
+// buffer is handed to the thread, and formatting continues into a second buffer while the first one is written.
+// Methods throw TableException if writing fails, (with a writer thread, on the first call following the failure).
+class ResultWriter
+{
+public:
+    // Append one line, containing the values of the row.
+    void write_row(const Row* row);
+
+    // Write everything appended so far, and (with a writer thread) wait for it to be written.
+    void flush();
+
+    ResultWriter(int fd, ResultFormat format, size_t buffer_size = 1 << 20, bool writer_thread = false);
+
+    // Flushes, discarding errors, and stops the writer thread.
+    ~ResultWriter();
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+private:
+    void append(const char* data, size_t n);
+    void append_field(const string& value);
+    void hand_off();
+    void write_all(const char* data, size_t n);
+    void write_pending();
+    void check_error();
+
+private:
+    int _fd;
+    ResultFormat _format;
+    vector<char> _buffer;
+    size_t _size;                   // Bytes of _buffer in use
+    bool _threaded;
+    thread _writer;
+    mutex _lock;                    // Protects the members below
+    condition_variable _changed;
+    vector<char> _pending;          // A full buffer, owned by the writer thread while _has_pending is set
+    size_t _pending_size;
+    bool _has_pending;
+    bool _stopping;
+    string _error;
+};
+
+/*
+ * Write all rows of input to the file descriptor fd, one per line, in the given format, through a ResultWriter
+ * with a buffer of buffer_size bytes, (and a writer thread, if writer_thread is true). Rows are released as
+ * they are written. Returns the number of rows written. Throws TableException if writing fails.
+ */
+unsigned long write_iterator(Iterator* input,
+                             int fd,
+                             ResultFormat format = TSV,
+                             bool writer_thread = false,
+                             size_t buffer_size = 1 << 20);
+
+#endif //RESULTWRITER_H
@@ -10,14 +10,12 @@ const Table *Row::table() const
 const string &Row::value(const string &column) const
 {
     assert(_table != NULL);
-    const ColumnNames &columns = _table->columns();
-    unsigned long n = columns.size();
-    for (unsigned i = 0; i < n; i++) {
-        if (columns.at(i) == column) {
-            return at(i);
-        }
-    }
-    throw RowException("Unknown column");
+    return value(ColumnHandle(_table->columns(), column));
+}
+
+const string &Row::value(const ColumnHandle& column) const
+{
+    return at(column.position());
 }
 
 void Row::append(const string &value)
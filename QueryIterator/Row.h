@@ -7,6 +7,7 @@
 using namespace std;
 
 class Table;
+class ColumnHandle;
 
 class Row: public vector<string>
 {
@@ -17,6 +18,9 @@ public:
     // The value for the given column in this Row
     const string &value(const string &column) const;
 
+    // The value for the column of the given handle, (which must have been resolved in the columns of this Row)
+    const string &value(const ColumnHandle& column) const;
+
     // Append a value to this Row
     void append(const string& value);
 
@@ -42,6 +46,15 @@ private:
 };
 
 typedef bool (*RowPredicate)(const Row*);
+
+// A predicate on one column of a row: lo <= row->at(column) <= hi, comparing strings as strcmp does.
+struct ColumnRange
+{
+    unsigned column;
+    string lo;
+    string hi;
+};
+
 class RowList: public vector<Row*> {};
 
 #endif //ROW_H
@@ -0,0 +1,283 @@
+#include "Scheduler.h"
+
+// The scheduler and worker index of the calling thread, if it is a worker.
+static thread_local Scheduler* current_scheduler = NULL;
+static thread_local int current_worker_index = -1;
+
+unsigned Scheduler::_configured_workers = 0;
+
+//----------------------------------------------------------------------
+
+// Scheduler
+
+unsigned Scheduler::n_workers() const
+{
+    return (unsigned) _workers.size();
+}
+
+Scheduler::Scheduler(unsigned n_workers)
+    : _queued(0),
+      _stopping(false)
+{
+    if (n_workers == 0) {
+        n_workers = thread::hardware_concurrency();
+    }
+    if (n_workers == 0) {
+        n_workers = 1;
+    }
+    for (unsigned i = 0; i < n_workers; i++) {
+        _workers.emplace_back(new Worker());
+    }
+    for (unsigned i = 0; i < n_workers; i++) {
+        _workers.at(i)->runner = thread(&Scheduler::work, this, i);
+    }
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        lock_guard<mutex> lock(_lock);
+        _stopping = true;
+    }
+    _work_available.notify_all();
+    // A worker that is still running may be stealing from any of the others, so none is deleted until all have
+    // stopped.
+    for (Worker* worker : _workers) {
+        worker->runner.join();
+    }
+    for (Worker* worker : _workers) {
+        delete worker;
+    }
+    _workers.clear();
+}
+
+Scheduler& Scheduler::instance()
+{
+    static Scheduler scheduler(_configured_workers);
+    return scheduler;
+}
+
+void Scheduler::configure(unsigned n_workers)
+{
+    _configured_workers = n_workers;
+}
+
+void Scheduler::submit(TaskGroup* group, const Task& task)
+{
+    int worker = current_worker();
+    if (worker >= 0) {
+        // Spawned by a running task: keep it local, where it is likely to be run soon by this same worker. It is
+        // counted before it is published, since a thief may take it, (and uncount it), as soon as it is.
+        _queued++;
+        {
+            lock_guard<mutex> lock(_workers.at(worker)->lock);
+            _workers.at(worker)->tasks.push_back(Entry{group, task});
+        }
+        // Taking _lock orders this with a worker that is about to sleep, so the notification isn't lost.
+        lock_guard<mutex> lock(_lock);
+    } else {
+        lock_guard<mutex> lock(_lock);
+        group->_queued.push_back(task);
+        if (!group->_listed) {
+            _groups.push_back(group);
+            group->_listed = true;
+        }
+        _queued++;
+    }
+    _work_available.notify_one();
+}
+
+// Find a task to run: the newest task on the worker's own deque, then a task queued on a group, and finally
+// a task stolen from another worker. If group is not NULL, only that group's queue is considered.
+bool Scheduler::take(int worker, TaskGroup* group, Entry& entry)
+{
+    if (worker >= 0) {
+        Worker* self = _workers.at(worker);
+        lock_guard<mutex> lock(self->lock);
+        if (!self->tasks.empty()) {
+            entry = self->tasks.back();
+            self->tasks.pop_back();
+            _queued--;
+            return true;
+        }
+    }
+    if (take_from_groups(group, entry)) {
+        return true;
+    }
+    return worker >= 0 && steal(worker, entry);
+}
+
+bool Scheduler::take_from_groups(TaskGroup* group, Entry& entry)
+{
+    lock_guard<mutex> lock(_lock);
+    if (group != NULL) {
+        if (group->_queued.empty()) {
+            return false;
+        }
+        entry = Entry{group, group->_queued.front()};
+        group->_queued.pop_front();
+        if (group->_queued.empty() && group->_listed) {
+            _groups.remove(group);
+            group->_listed = false;
+        }
+        _queued--;
+        return true;
+    }
+    while (!_groups.empty()) {
+        TaskGroup* next = _groups.front();
+        _groups.pop_front();
+        if (next->_queued.empty()) {
+            next->_listed = false;
+            continue;
+        }
+        entry = Entry{next, next->_queued.front()};
+        next->_queued.pop_front();
+        // Go to the back of the line, so that other groups get the next turns.
+        if (next->_queued.empty()) {
+            next->_listed = false;
+        } else {
+            _groups.push_back(next);
+        }
+        _queued--;
+        return true;
+    }
+    return false;
+}
+
+bool Scheduler::steal(int thief, Entry& entry)
+{
+    unsigned n = n_workers();
+    for (unsigned k = 1; k < n; k++) {
+        Worker* victim = _workers.at((thief + k) % n);
+        lock_guard<mutex> lock(victim->lock);
+        if (!victim->tasks.empty()) {
+            entry = victim->tasks.front();
+            victim->tasks.pop_front();
+            _queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::execute(Entry& entry)
+{
+    exception_ptr error;
+    try {
+        entry.task();
+    } catch (...) {
+        error = current_exception();
+    }
+    entry.group->finish(error);
+}
+
+void Scheduler::work(unsigned worker)
+{
+    current_scheduler = this;
+    current_worker_index = (int) worker;
+    while (true) {
+        Entry entry;
+        if (take((int) worker, NULL, entry)) {
+            execute(entry);
+        } else {
+            unique_lock<mutex> lock(_lock);
+            _work_available.wait(lock, [this] { return _stopping || _queued > 0; });
+            if (_stopping) {
+                return;
+            }
+        }
+    }
+}
+
+int Scheduler::current_worker() const
+{
+    return current_scheduler == this ? current_worker_index : -1;
+}
+
+//----------------------------------------------------------------------
+
+// TaskGroup
+
+void TaskGroup::run(const Scheduler::Task& task)
+{
+    {
+        lock_guard<mutex> lock(_lock);
+        _pending++;
+    }
+    _scheduler.submit(this, task);
+}
+
+void TaskGroup::wait()
+{
+    int worker = _scheduler.current_worker();
+    while (true) {
+        Scheduler::Entry entry;
+        if (_scheduler.take(worker, this, entry)) {
+            _scheduler.execute(entry);
+        } else {
+            // Everything left is running (or queued on a busy worker's deque, which will get to it).
+            unique_lock<mutex> lock(_lock);
+            _done.wait(lock, [this] { return _pending == 0; });
+        }
+        unique_lock<mutex> lock(_lock);
+        if (_pending == 0) {
+            break;
+        }
+    }
+    exception_ptr error;
+    {
+        lock_guard<mutex> lock(_lock);
+        error = _error;
+        _error = nullptr;
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+void TaskGroup::finish(exception_ptr error)
+{
+    lock_guard<mutex> lock(_lock);
+    if (error && !_error) {
+        _error = error;
+    }
+    if (--_pending == 0) {
+        _done.notify_all();
+    }
+}
+
+TaskGroup::TaskGroup(Scheduler& scheduler)
+    : _scheduler(scheduler),
+      _listed(false),
+      _pending(0)
+{}
+
+TaskGroup::~TaskGroup()
+{
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+//----------------------------------------------------------------------
+
+void parallel_for(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& body)
+{
+    if (begin >= end) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    if (end - begin <= grain || Scheduler::instance().n_workers() == 1) {
+        body(begin, end);
+        return;
+    }
+    TaskGroup group;
+    for (size_t lo = begin; lo < end; lo += grain) {
+        size_t hi = end - lo < grain ? end : lo + grain;
+        group.run([&body, lo, hi] { body(lo, hi); });
+    }
+    group.wait();
+}
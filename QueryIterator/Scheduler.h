@@ -0,0 +1,153 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class TaskGroup;
+
+// A fixed pool of worker threads shared by all queries. Each worker owns a deque of tasks: tasks submitted
+// by a task running on a worker go onto that worker's deque, which the worker runs newest-first. An idle worker
+// steals the oldest task from another worker's deque. Tasks submitted from outside the pool (e.g. by the thread
+// running a query) are queued on their TaskGroup, and workers take from the active groups in round-robin order,
+// so that concurrent queries share the workers fairly no matter how many tasks each one submits.
+class Scheduler
+{
+public:
+    typedef function<void()> Task;
+
+    // The number of worker threads.
+    unsigned n_workers() const;
+
+    // Create a scheduler with the given number of workers. 0 means one worker per hardware thread.
+    explicit Scheduler(unsigned n_workers);
+
+    // Stop the workers. All task groups using this scheduler must have been waited for.
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+public:
+    // The scheduler shared by the query processor, created on first use.
+    static Scheduler& instance();
+
+    // Set the number of workers of the shared scheduler, (0 means one per hardware thread). Must be called
+    // before the first call of instance() to have any effect.
+    static void configure(unsigned n_workers);
+
+private:
+    friend class TaskGroup;
+
+    struct Entry
+    {
+        TaskGroup* group;
+        Task task;
+    };
+
+    struct Worker
+    {
+        mutex lock;
+        deque<Entry> tasks;
+        thread runner;
+    };
+
+    void submit(TaskGroup* group, const Task& task);
+    bool take(int worker, TaskGroup* group, Entry& entry);
+    bool take_from_groups(TaskGroup* group, Entry& entry);
+    bool steal(int thief, Entry& entry);
+    void execute(Entry& entry);
+    void work(unsigned worker);
+    int current_worker() const;
+
+private:
+    vector<Worker*> _workers;
+    mutex _lock;                            // Protects _groups, group queues, and _stopping
+    condition_variable _work_available;
+    list<TaskGroup*> _groups;               // Groups with queued tasks, in round-robin order
+    atomic<unsigned long> _queued;          // Tasks in all deques and group queues
+    bool _stopping;
+
+    static unsigned _configured_workers;
+};
+
+// A set of related tasks, typically those of one query. Tasks can be added from any thread, including from
+// tasks of the same group.
+class TaskGroup
+{
+public:
+    // Queue the task for execution by the scheduler.
+    void run(const Scheduler::Task& task);
+
+    // Wait for all tasks of this group to finish. The calling thread helps to run queued tasks meanwhile.
+    // If any task threw an exception, the first one is rethrown here.
+    void wait();
+
+    explicit TaskGroup(Scheduler& scheduler = Scheduler::instance());
+
+    // Waits for any tasks still running. Exceptions thrown by tasks are discarded.
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+private:
+    friend class Scheduler;
+
+    void finish(exception_ptr error);
+
+private:
+    Scheduler& _scheduler;
+    deque<Scheduler::Task> _queued;         // Protected by the scheduler's lock
+    bool _listed;                           // Protected by the scheduler's lock
+    mutex _lock;                            // Protects _pending and _error
+    condition_variable _done;
+    unsigned long _pending;
+    exception_ptr _error;
+};
+
+// Run body(lo, hi) over consecutive subranges of [begin, end), each containing at most grain positions, in
+// parallel on the shared scheduler. Returns when every subrange is done.
+void parallel_for(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& body);
+
+// Stable sort of items, in parallel on the shared scheduler: runs of at least grain items are sorted concurrently,
+// and then merged pairwise, in rounds, with the merges of a round running concurrently.
+template <typename T, typename Less>
+void parallel_stable_sort(vector<T>& items, Less less, size_t grain = 1 << 14)
+{
+    size_t n = items.size();
+    size_t n_workers = Scheduler::instance().n_workers();
+    if (n <= grain || n_workers == 1) {
+        stable_sort(items.begin(), items.end(), less);
+        return;
+    }
+    size_t run = max(grain, (n + 4 * n_workers - 1) / (4 * n_workers));
+    parallel_for(0, (n + run - 1) / run, 1, [&](size_t lo, size_t hi) {
+        for (size_t r = lo; r < hi; r++) {
+            stable_sort(items.begin() + r * run, items.begin() + min(n, (r + 1) * run), less);
+        }
+    });
+    for (size_t width = run; width < n; width *= 2) {
+        size_t n_pairs = (n + 2 * width - 1) / (2 * width);
+        parallel_for(0, n_pairs, 1, [&](size_t lo, size_t hi) {
+            for (size_t p = lo; p < hi; p++) {
+                size_t begin = p * 2 * width;
+                size_t middle = min(n, begin + width);
+                size_t end = min(n, begin + 2 * width);
+                inplace_merge(items.begin() + begin, items.begin() + middle, items.begin() + end, less);
+            }
+        });
+    }
+}
+
+#endif //SCHEDULER_H
@@ -0,0 +1,177 @@
+#include <set>
+#include "Snapshot.h"
+#include "Database.h"
+#include "BinaryFormat.h"
+#include "MappedFile.h"
+#include "Scheduler.h"
+
+static const char SNAPSHOT_MAGIC[8] = {'Q', 'I', 'S', 'N', 'A', 'P', 'S', 'H'};
+static const uint32_t SNAPSHOT_VERSION = 3;
+
+// Table flags
+static const uint32_t PAGED = 1;
+
+//----------------------------------------------------------------------
+
+// Writing
+
+static void write_table(BinaryWriter& writer, Table* table)
+{
+    writer.str(table->name());
+    const ColumnNames& columns = table->columns();
+    writer.u32((uint32_t) columns.size());
+    for (const string& column : columns) {
+        writer.str(column);
+    }
+    writer.u32(table->paged() ? PAGED : 0);
+    size_t n_rows = table->n_rows();
+    writer.u64(n_rows);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < n_rows; i++) {
+        Row* row = table->row(i);
+        for (const string& value : *row) {
+            writer.u64(offset);
+            offset += value.size();
+        }
+        Row::reclaim(row);
+    }
+    writer.u64(offset);
+    for (size_t i = 0; i < n_rows; i++) {
+        Row* row = table->row(i);
+        for (const string& value : *row) {
+            writer.bytes(value.data(), value.size());
+        }
+        Row::reclaim(row);
+    }
+}
+
+void save_snapshot(const vector<Table*>& tables, const string& path, uint64_t log_sequence)
+{
+    BinaryWriter writer(path);
+    writer.bytes(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writer.u32(SNAPSHOT_VERSION);
+    writer.u32(BYTE_ORDER_MARK);
+    writer.u64(log_sequence);
+    writer.u32((uint32_t) tables.size());
+    for (Table* table : tables) {
+        write_table(writer, table);
+    }
+    writer.commit();
+}
+
+//----------------------------------------------------------------------
+
+// Reading
+
+// The location of a table's data in the mapped snapshot file.
+struct TableImage
+{
+    string name;
+    ColumnNames columns;
+    uint32_t flags;
+    uint64_t n_rows;
+    const char* offsets;    // n_rows * columns.size() + 1 u64 values, possibly unaligned
+    const char* heap;
+    uint64_t heap_size;
+
+    uint64_t offset(uint64_t i) const
+    {
+        return u64_at(offsets, i);
+    }
+
+    TableImage() : columns({}), flags(0) {}
+};
+
+static void read_table_image(BinaryReader& cursor, uint32_t version, TableImage& image)
+{
+    image.name = cursor.str();
+    uint32_t n_columns = cursor.u32();
+    set<string> column_set;
+    for (uint32_t i = 0; i < n_columns; i++) {
+        image.columns.emplace_back(cursor.str());
+        if (!column_set.insert(image.columns.back()).second) {
+            throw TableException("Corrupt snapshot");
+        }
+    }
+    if (version >= 3) {
+        image.flags = cursor.u32();
+    }
+    image.n_rows = cursor.u64();
+    if (n_columns == 0 || image.n_rows > cursor.remaining() / sizeof(uint64_t) / n_columns) {
+        throw TableException("Corrupt snapshot");
+    }
+    uint64_t n_values = image.n_rows * n_columns;
+    image.offsets = cursor.take((n_values + 1) * sizeof(uint64_t));
+    image.heap_size = image.offset(n_values);
+    image.heap = cursor.take(image.heap_size);
+    // Offsets must be non-decreasing and within the heap.
+    atomic<bool> valid(image.offset(0) == 0);
+    parallel_for(0, n_values, 1 << 16, [&image, &valid](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi && valid; i++) {
+            if (image.offset(i) > image.offset(i + 1)) {
+                valid = false;
+            }
+        }
+    });
+    if (!valid) {
+        throw TableException("Corrupt snapshot");
+    }
+}
+
+static void load_rows(const TableImage& image, Table* table)
+{
+    size_t n_columns = image.columns.size();
+    vector<Row*> rows(image.n_rows);
+    parallel_for(0, image.n_rows, 1 << 12, [&](size_t lo, size_t hi) {
+        for (size_t r = lo; r < hi; r++) {
+            Row* row = new Row(table);
+            row->reserve(n_columns);
+            for (size_t c = 0; c < n_columns; c++) {
+                uint64_t i = r * n_columns + c;
+                uint64_t start = image.offset(i);
+                row->emplace_back(image.heap + start, image.offset(i + 1) - start);
+            }
+            rows.at(r) = row;
+        }
+    });
+    RowList batch;
+    batch.insert(batch.end(), rows.begin(), rows.end());
+    table->add_all(batch);
+}
+
+vector<Table*> load_snapshot(const string& path, uint64_t* log_sequence, BufferPool* pool)
+{
+    MappedFile file(path);
+    BinaryReader cursor(file.data(), file.size());
+    if (memcmp(cursor.take(sizeof(SNAPSHOT_MAGIC)), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw TableException(path + " is not a snapshot");
+    }
+    uint32_t version = cursor.u32();
+    if (version < 1 || version > SNAPSHOT_VERSION) {
+        throw TableException("Unsupported snapshot version");
+    }
+    if (cursor.u32() != BYTE_ORDER_MARK) {
+        throw TableException("Snapshot was written with a different byte order");
+    }
+    uint64_t sequence = version == 1 ? 0 : cursor.u64();
+    uint32_t n_tables = cursor.u32();
+    // Check everything before creating any tables.
+    vector<TableImage> images(n_tables);
+    set<string> names;
+    for (TableImage& image : images) {
+        read_table_image(cursor, version, image);
+        if (!names.insert(image.name).second || Database::table(image.name) != NULL) {
+            throw TableException("Table name already in use");
+        }
+    }
+    vector<Table*> tables;
+    for (const TableImage& image : images) {
+        Table* table = Database::new_table(image.name, image.columns, (image.flags & PAGED) ? pool : NULL);
+        load_rows(image, table);
+        tables.emplace_back(table);
+    }
+    if (log_sequence != NULL) {
+        *log_sequence = sequence;
+    }
+    return tables;
+}
@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Table;
+class BufferPool;
+
+/*
+ * Binary table snapshots, for restarting without re-parsing .csv files. A snapshot file contains:
+ *
+ *     header:  magic "QISNAPSH", u32 format version, u32 byte order mark (0x01020304), u64 log sequence number,
+ *              u32 number of tables
+ *     tables:  for each table:
+ *                  name:     u32 length, bytes
+ *                  columns:  u32 number of columns, then for each, u32 length, bytes
+ *                  flags:    u32, 1 if the table's rows are stored in pages
+ *                  rows:     u64 number of rows (n)
+ *                  offsets:  u64 x (n * number of columns + 1): the start of each value in the heap, in row-major
+ *                            order, followed by the heap size
+ *                  heap:     the bytes of all values, concatenated
+ *
+ * Integers are in the byte order of the machine that wrote the file; a reader with a different byte order rejects
+ * the file. Loading maps the file and slices each value out of the heap, with the rows of each table built in
+ * parallel. The log sequence number (see WriteAheadLog) is absent in version 1 files, and taken to be 0. Table
+ * flags are absent in version 1 and 2 files, and taken to be 0.
+ */
+
+// Write the given tables to a snapshot file at path. The file is written under a temporary name, and then renamed
+// to path, so a crash never leaves a partially written snapshot at path. Throws TableException on I/O errors.
+void save_snapshot(const vector<Table*>& tables, const string& path, uint64_t log_sequence = 0);
+
+// Create the tables stored in the snapshot file at path, using Database::new_table, (paged tables in pool's pages,
+// or in memory if pool is NULL). Returns the new tables, in
+// the order in which they were saved. Throws TableException if the file can't be read, is not a snapshot, has an
+// unsupported version, or is truncated, (in which case no tables are created). If log_sequence is not NULL, it is
+// set to the snapshot's log sequence number.
+vector<Table*> load_snapshot(const string& path, uint64_t* log_sequence = NULL, BufferPool* pool = NULL);
+
+#endif //SNAPSHOT_H
@@ -0,0 +1,83 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// Bounded, lock-free queue for exactly one producer thread and one consumer thread. The capacity
+// is rounded up to a power of two. push and pop never block: push returns false when the queue is
+// full, and pop returns false when it is empty, so callers implement their own waiting (and thereby
+// backpressure).
+template <typename T>
+class SpscQueue
+{
+public:
+    // Called by the producer only.
+    bool push(const T& value)
+    {
+        size_t tail = _tail.load(memory_order_relaxed);
+        if (tail - _head.load(memory_order_acquire) == _capacity) {
+            return false;
+        }
+        _slots[tail & _mask] = value;
+        _tail.store(tail + 1, memory_order_release);
+        return true;
+    }
+
+    // Called by the consumer only.
+    bool pop(T& value)
+    {
+        size_t head = _head.load(memory_order_relaxed);
+        if (head == _tail.load(memory_order_acquire)) {
+            return false;
+        }
+        value = _slots[head & _mask];
+        _head.store(head + 1, memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    explicit SpscQueue(size_t capacity)
+        : _capacity(round_up(capacity)),
+          _mask(_capacity - 1),
+          _slots(new T[_capacity]),
+          _head(0),
+          _tail(0)
+    {}
+
+    ~SpscQueue()
+    {
+        delete [] _slots;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+private:
+    static size_t round_up(size_t n)
+    {
+        size_t capacity = 1;
+        while (capacity < n) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+private:
+    const size_t _capacity;
+    const size_t _mask;
+    T* _slots;
+    // head and tail are kept on separate cache lines so that the two threads don't false-share.
+    char _pad0[64];
+    atomic<size_t> _head;
+    char _pad1[64];
+    atomic<size_t> _tail;
+};
+
+#endif //SPSCQUEUE_H
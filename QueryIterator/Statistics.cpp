@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include "Statistics.h"
+#include "Table.h"
+#include "BinaryFormat.h"
+#include "dbexceptions.h"
+
+// 2^HLL_BITS registers, for a standard error of 1.04 / sqrt(2^HLL_BITS)
+static const unsigned HLL_BITS = 12;
+
+static const size_t MAX_MOST_COMMON = 8;
+static const size_t MAX_BUCKETS = 16;
+
+//----------------------------------------------------------------------
+
+// HyperLogLog
+
+void HyperLogLog::add(const string& value)
+{
+    // The top bits choose a register, which keeps the longest run of leading zeros seen in the other bits.
+    uint64_t hash = fnv_finish(fnv_add(FNV_OFFSET, value));
+    uint64_t rest = hash << HLL_BITS;
+    uint8_t rank = rest == 0 ? 64 - HLL_BITS + 1 : (uint8_t) (__builtin_clzll(rest) + 1);
+    uint8_t& reg = _registers[hash >> (64 - HLL_BITS)];
+    reg = max(reg, rank);
+}
+
+double HyperLogLog::estimate() const
+{
+    double m = (double) _registers.size();
+    double sum = 0;
+    unsigned n_zeros = 0;
+    for (uint8_t reg : _registers) {
+        sum += ldexp(1.0, -reg);
+        n_zeros += reg == 0;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // For small cardinalities, count the empty registers instead, (linear counting).
+    if (estimate <= 2.5 * m && n_zeros > 0) {
+        estimate = m * log(m / n_zeros);
+    }
+    return estimate;
+}
+
+HyperLogLog::HyperLogLog()
+    : _registers(1u << HLL_BITS, 0)
+{}
+
+//----------------------------------------------------------------------
+
+// ColumnStatistics
+
+const string& ColumnStatistics::min() const
+{
+    return _min;
+}
+
+const string& ColumnStatistics::max() const
+{
+    return _max;
+}
+
+double ColumnStatistics::n_distinct() const
+{
+    // The estimate can't exceed the number of rows.
+    return std::min(_distinct.estimate(), (double) _n_rows);
+}
+
+const vector<pair<string, size_t>>& ColumnStatistics::most_common() const
+{
+    return _most_common;
+}
+
+const vector<HistogramBucket>& ColumnStatistics::histogram() const
+{
+    return _histogram;
+}
+
+double ColumnStatistics::selectivity(const string& lo, const string& hi) const
+{
+    if (_n_rows == 0 || hi < lo || hi < _min || lo > _max) {
+        return 0;
+    }
+    double n = (double) _n_rows;
+    if (lo == hi) {
+        // A common value is counted. The other rows are spread evenly over the other values.
+        size_t common_rows = 0;
+        for (const pair<string, size_t>& common : _most_common) {
+            if (common.first == lo) {
+                return common.second / n;
+            }
+            common_rows += common.second;
+        }
+        double other_values = std::max(1.0, n_distinct() - _most_common.size());
+        return (n - common_rows) / n / other_values;
+    }
+    // Buckets within the range are counted, and half of each bucket that straddles one of its ends.
+    double rows = 0;
+    const string* bucket_lo = &_min;
+    for (const HistogramBucket& bucket : _histogram) {
+        if (lo <= *bucket_lo && bucket.hi <= hi) {
+            rows += bucket.n_rows;
+        } else if (!(bucket.hi < lo || hi < *bucket_lo)) {
+            rows += bucket.n_rows / 2.0;
+        }
+        bucket_lo = &bucket.hi;
+    }
+    return std::min(1.0, rows / n);
+}
+
+ColumnStatistics::ColumnStatistics()
+    : _n_rows(0)
+{}
+
+void ColumnStatistics::analyze(vector<string>& values)
+{
+    _n_rows = values.size();
+    _distinct = HyperLogLog();
+    _most_common.clear();
+    _histogram.clear();
+    for (const string& value : values) {
+        _distinct.add(value);
+    }
+    sort(values.begin(), values.end());
+    _min = values.empty() ? "" : values.front();
+    _max = values.empty() ? "" : values.back();
+    // Runs of equal values give the most common values.
+    for (size_t start = 0, end; start < values.size(); start = end) {
+        for (end = start + 1; end < values.size() && values[end] == values[start]; end++)
+            ;
+        if (end - start > 1) {
+            _most_common.emplace_back(values[start], end - start);
+        }
+    }
+    stable_sort(_most_common.begin(), _most_common.end(),
+                [](const pair<string, size_t>& x, const pair<string, size_t>& y) { return x.second > y.second; });
+    if (_most_common.size() > MAX_MOST_COMMON) {
+        _most_common.resize(MAX_MOST_COMMON);
+    }
+    // Bucket b ends at about row (b + 1) * n / n_buckets, moved forward past any rows with the same value.
+    size_t n_buckets = std::min(MAX_BUCKETS, values.size());
+    for (size_t b = 0, start = 0; b < n_buckets && start < values.size(); b++) {
+        size_t end = std::max(start + 1, (b + 1) * values.size() / n_buckets);
+        while (end < values.size() && values[end] == values[end - 1]) {
+            end++;
+        }
+        _histogram.push_back(HistogramBucket{values[end - 1], end - start});
+        start = end;
+    }
+}
+
+void ColumnStatistics::add(const string& value)
+{
+    if (_n_rows == 0 || value < _min) {
+        _min = value;
+    }
+    if (_n_rows == 0 || value > _max) {
+        _max = value;
+    }
+    _n_rows++;
+    _distinct.add(value);
+    for (size_t i = 0; i < _most_common.size(); i++) {
+        if (_most_common[i].first == value) {
+            _most_common[i].second++;
+            for (; i > 0 && _most_common[i].second > _most_common[i - 1].second; i--) {
+                swap(_most_common[i], _most_common[i - 1]);
+            }
+            break;
+        }
+    }
+    // The first bucket whose hi is at least value gets the row. The last bucket is extended for a new max.
+    auto bucket = lower_bound(_histogram.begin(), _histogram.end(), value,
+                              [](const HistogramBucket& b, const string& v) { return b.hi < v; });
+    if (bucket == _histogram.end()) {
+        if (_histogram.empty()) {
+            _histogram.push_back(HistogramBucket{value, 0});
+        }
+        bucket = _histogram.end() - 1;
+        bucket->hi = value;
+    }
+    bucket->n_rows++;
+}
+
+//----------------------------------------------------------------------
+
+// TableStatistics
+
+size_t TableStatistics::n_rows() const
+{
+    return _n_rows;
+}
+
+const ColumnStatistics& TableStatistics::column(unsigned position) const
+{
+    return _columns.at(position);
+}
+
+const ColumnStatistics& TableStatistics::column(const string& name) const
+{
+    int position = _table->columns().position(name);
+    if (position == -1) {
+        throw TableException("Unknown column " + name);
+    }
+    return _columns.at((unsigned) position);
+}
+
+void TableStatistics::add(Row* const* rows, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        for (unsigned c = 0; c < _columns.size(); c++) {
+            _columns[c].add(rows[i]->at(c));
+        }
+    }
+    _n_rows += n;
+}
+
+TableStatistics::TableStatistics(Table* table)
+    : _table(table),
+      _n_rows(table->n_rows()),
+      _columns(table->columns().size())
+{
+    vector<vector<string>> values(_columns.size());
+    for (vector<string>& column_values : values) {
+        column_values.reserve(_n_rows);
+    }
+    for (size_t i = 0; i < _n_rows; i++) {
+        Row* row = table->row(i);
+        for (unsigned c = 0; c < _columns.size(); c++) {
+            values[c].push_back(row->at(c));
+        }
+        Row::reclaim(row);
+    }
+    for (unsigned c = 0; c < _columns.size(); c++) {
+        _columns[c].analyze(values[c]);
+        vector<string>().swap(values[c]);
+    }
+}
+
+const TableStatistics* analyze(Table* table)
+{
+    TableStatistics* statistics = new TableStatistics(table);
+    delete table->_statistics;
+    table->_statistics = statistics;
+    return statistics;
+}
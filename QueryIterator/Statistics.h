@@ -0,0 +1,102 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Row;
+class Table;
+
+// An estimate of the number of distinct values added, in 4KB, whatever the number of values, (within about 2%).
+class HyperLogLog
+{
+public:
+    void add(const string& value);
+
+    double estimate() const;
+
+    HyperLogLog();
+
+private:
+    vector<uint8_t> _registers;
+};
+
+// A bucket of an equi-depth histogram: the values greater than the previous bucket's hi, (or at least the column's
+// min, for the first bucket), and at most hi.
+struct HistogramBucket
+{
+    string hi;
+    size_t n_rows;
+};
+
+class ColumnStatistics
+{
+public:
+    // The smallest and largest values, as compared by strcmp, (empty if there are no rows)
+    const string& min() const;
+    const string& max() const;
+
+    // An estimate of the number of distinct values
+    double n_distinct() const;
+
+    // The most common values, and their numbers of rows, most common first. Only values in more than one row
+    // are included.
+    const vector<pair<string, size_t>>& most_common() const;
+
+    // Buckets holding about the same number of rows when analyzed, in order of their values. A value is never
+    // split between buckets.
+    const vector<HistogramBucket>& histogram() const;
+
+    // An estimate of the fraction of rows with values between lo and hi, inclusive
+    double selectivity(const string& lo, const string& hi) const;
+
+    ColumnStatistics();
+
+private:
+    friend class TableStatistics;
+
+    void analyze(vector<string>& values);
+    void add(const string& value);
+
+private:
+    size_t _n_rows;
+    string _min;
+    string _max;
+    HyperLogLog _distinct;
+    vector<pair<string, size_t>> _most_common;
+    vector<HistogramBucket> _histogram;
+};
+
+// Statistics of the columns of a table, computed by analyze, and then kept up to date by Table::add and add_all.
+// Row counts, min and max values, and distinct value estimates stay exact, (as exact as they were). New rows are
+// also counted in the histogram buckets and most common values, but the buckets' bounds and the choice of most
+// common values stay as analyzed, so after many changes, analyze again to rebalance them.
+class TableStatistics
+{
+public:
+    size_t n_rows() const;
+
+    const ColumnStatistics& column(unsigned position) const;
+
+    // The statistics of the named column. Throws TableException if there is no such column.
+    const ColumnStatistics& column(const string& name) const;
+
+    // Count rows that have been added to the table.
+    void add(Row* const* rows, size_t n);
+
+    explicit TableStatistics(Table* table);
+
+private:
+    const Table* _table;
+    size_t _n_rows;
+    vector<ColumnStatistics> _columns;
+};
+
+// Compute statistics of the table's columns, (replacing any previous ones), reading all its rows, and keep them
+// up to date as rows are added. Returns the statistics, which are also available from Table::statistics.
+const TableStatistics* analyze(Table* table);
+
+#endif //STATISTICS_H
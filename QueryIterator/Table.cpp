@@ -1,12 +1,47 @@
+#include <algorithm>
 #include <cstring>
 #include <cassert>
 #include "Table.h"
 #include "Index.h"
 #include "Row.h"
+#include "Scheduler.h"
+#include "Statistics.h"
+#include "WriteAheadLog.h"
+#include "BinaryFormat.h"
+#include "MappedFile.h"
 #include "dbexceptions.h"
 
 using namespace std;
 
+const size_t Table::ZONE_ROWS;
+
+static void encode_record(const Row* row, string& record)
+{
+    record.clear();
+    for (const string& value : *row) {
+        uint64_t x = value.size();
+        while (x >= 0x80) {
+            record += (char) (x | 0x80);
+            x >>= 7;
+        }
+        record += (char) x;
+        record += value;
+    }
+}
+
+static uint64_t get_varint(const char*& p, const char* end)
+{
+    uint64_t x = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = (unsigned char) *p++;
+        x |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return x;
+        }
+    }
+    throw TableException("Corrupt page");
+}
+
 const string &Table::name() const
 {
     return _name;
@@ -22,45 +57,361 @@ RowList& Table::rows()
     return _rows;
 }
 
+size_t Table::n_rows() const
+{
+    return _pool == NULL ? _rows.size() : (_page_ends.empty() ? 0 : _page_ends.back());
+}
+
+bool Table::paged() const
+{
+    return _pool != NULL;
+}
+
+Row* Table::row(size_t position) const
+{
+    if (_pool == NULL) {
+        return _rows.at(position);
+    }
+    if (position >= n_rows()) {
+        throw TableException("No such row");
+    }
+    size_t p = upper_bound(_page_ends.begin(), _page_ends.end(), position) - _page_ends.begin();
+    size_t first = p == 0 ? 0 : _page_ends.at(p - 1);
+    PageId page_id = _pages.at(p);
+    const char* page = _pool->pin(page_id);
+    size_t size;
+    const char* record = SlottedPage::record(page, (unsigned) (position - first), &size);
+    Row* row = new Row();
+    row->reserve(_columns.size());
+    const char* end = record + size;
+    for (size_t c = 0; c < _columns.size(); c++) {
+        uint64_t length = get_varint(record, end);
+        row->emplace_back(record, length);
+        record += length;
+    }
+    _pool->unpin(page_id, false);
+    return row;
+}
+
 void Table::add(Row* row)
 {
-    const ColumnNames& source_columns = row->table()->columns();
-    const ColumnNames& target_columns = _columns;
-    if (row->size() != _columns.size()) {
-        throw TableException("row size is wrong");
+    check_row(row);
+    if (_pool != NULL) {
+        check_record_size(row);
     }
-    if (source_columns.size() != target_columns.size()) {
-        throw TableException("source and target metadata incompatible");
+    size_t first_row = n_rows();
+    if (_pool == NULL) {
+        _rows.emplace_back(row);
+    } else {
+        append_to_pages(&row, 1);
+    }
+    // Log only once the row is stored, so that a failure to store it, (e.g. no free frame), doesn't leave a record
+    // of a row the table doesn't have.
+    if (_log != NULL) {
+        _log->log_rows(_name, &row, 1);
+    }
+    update_zones(first_row, &row, 1);
+    if (_statistics != NULL) {
+        _statistics->add(&row, 1);
+    }
+    if (_pool != NULL) {
+        delete row;
+    }
+    _version++;
+}
+
+void Table::add_all(const RowList& rows)
+{
+    for (Row* row : rows) {
+        check_row(row);
+        if (_pool != NULL) {
+            check_record_size(row);
+        }
+    }
+    if (!rows.empty()) {
+        size_t first_row = n_rows();
+        if (_pool == NULL) {
+            _rows.insert(_rows.end(), rows.begin(), rows.end());
+        } else {
+            append_to_pages(rows.data(), rows.size());
+        }
+        if (_log != NULL) {
+            _log->log_rows(_name, rows.data(), rows.size());
+        }
+        update_zones(first_row, rows.data(), rows.size());
+        if (_statistics != NULL) {
+            _statistics->add(rows.data(), rows.size());
+        }
+        if (_pool != NULL) {
+            for (Row* row : rows) {
+                delete row;
+            }
+        }
+        _version++;
     }
-    _rows.emplace_back(row);
 }
 
 Index* Table::add_index(const ColumnNames& index_columns)
 {
-    Index* index = new Index(this);
+    Index* index = new Index(this, index_columns);
     unsigned n_key_columns = (unsigned) index_columns.size();
-    unsigned key_positions[n_key_columns];
-    unsigned k = 0;
-    for (const string& column : index_columns) {
-        int position = _columns.position(column);
-        assert(position != -1);
-        key_positions[k++] = (unsigned) position;
+    vector<unsigned> key_positions = this->key_positions(index_columns);
+    // Extract the keys in parallel, sort them in parallel, and then build the tree from the sorted run. The sort
+    // is stable, so that for duplicate keys, the index keeps the first row, as inserting row by row would.
+    // The entries of a paged table refer to rows by position, since its rows are only read back as needed.
+    vector<Index::Entry> entries(n_rows());
+    parallel_for(0, entries.size(), 1 << 12, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            Row* row = this->row(i);
+            vector<string>& key = entries.at(i).first;
+            key.reserve(n_key_columns);
+            for (unsigned k = 0; k < n_key_columns; k++) {
+                key.emplace_back(row->at(key_positions.at(k)));
+            }
+            entries.at(i).second = RowRef{_pool == NULL ? row : NULL, i};
+            Row::reclaim(row);
+        }
+    });
+    parallel_stable_sort(entries, [](const Index::Entry& x, const Index::Entry& y) { return x.first < y.first; });
+    index->put_sorted(entries);
+    _indexes.emplace_back(index);
+    return index;
+}
+
+const TableStatistics* Table::statistics() const
+{
+    return _statistics;
+}
+
+const vector<Index*>& Table::indexes() const
+{
+    return _indexes;
+}
+
+Index* Table::open_index(const string& path)
+{
+    MappedFile file(path);
+    BinaryReader reader(file.data(), file.size());
+    if (memcmp(reader.take(sizeof(INDEX_FILE_MAGIC)), INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC)) != 0) {
+        throw TableException(path + " is not an index file");
+    }
+    if (reader.u32() != INDEX_FILE_VERSION) {
+        throw TableException("Unsupported index file version");
     }
-    vector<string> key;
-    for (Row* row : _rows) {
-        key.clear();
-        for (unsigned i = 0; i < n_key_columns; i++) {
-            key.emplace_back(row->at(key_positions[i]));
+    if (reader.u32() != BYTE_ORDER_MARK) {
+        throw TableException("Index file was written with a different byte order");
+    }
+    string table_name = reader.str();
+    uint64_t table_version = reader.u64();
+    uint64_t n_rows = reader.u64();
+    uint32_t n_key_columns = reader.u32();
+    ColumnNames key_columns({});
+    for (uint32_t i = 0; i < n_key_columns; i++) {
+        key_columns.emplace_back(reader.str());
+    }
+    uint64_t fingerprint = reader.u64();
+    uint64_t n_entries = reader.u64();
+    if (n_entries > reader.remaining() / sizeof(uint64_t)) {
+        throw TableException("Truncated file");
+    }
+    const char* positions = reader.take(n_entries * sizeof(uint64_t));
+    // Is the index stale?
+    if (table_name != _name || table_version != _version || n_rows != this->n_rows()) {
+        return NULL;
+    }
+    for (const string& column : key_columns) {
+        if (_columns.position(column) == -1) {
+            return NULL;
         }
-        index->put(key, row);
     }
+    if (key_fingerprint(key_columns) != fingerprint) {
+        return NULL;
+    }
+    // The key values haven't changed, so the entries can be rebuilt from the rows at the saved positions,
+    // which are in key order.
+    vector<unsigned> key_positions = this->key_positions(key_columns);
+    vector<Index::Entry> entries(n_entries);
+    atomic<bool> valid(true);
+    parallel_for(0, n_entries, 1 << 12, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi && valid; i++) {
+            uint64_t position = u64_at(positions, i);
+            if (position >= n_rows) {
+                valid = false;
+                break;
+            }
+            Row* row = this->row(position);
+            vector<string>& key = entries.at(i).first;
+            key.reserve(n_key_columns);
+            for (unsigned k = 0; k < n_key_columns; k++) {
+                key.emplace_back(row->at(key_positions.at(k)));
+            }
+            entries.at(i).second = RowRef{_pool == NULL ? row : NULL, position};
+            Row::reclaim(row);
+        }
+    });
+    for (size_t i = 1; valid && i < n_entries; i++) {
+        valid = entries.at(i - 1).first < entries.at(i).first;
+    }
+    if (!valid) {
+        return NULL;
+    }
+    Index* index = new Index(this, key_columns);
+    index->put_sorted(entries);
     _indexes.emplace_back(index);
     return index;
 }
 
-Table::Table(const string &name, const ColumnNames &columns)
+const vector<Zone>& Table::zones() const
+{
+    return _zones;
+}
+
+unsigned long Table::version() const
+{
+    return _version;
+}
+
+uint64_t Table::key_fingerprint(const ColumnNames& key_columns) const
+{
+    // FNV-1a over fixed-size chunks of rows, hashed in parallel, and then combined in order, so that the result
+    // doesn't depend on the number of workers.
+    const size_t CHUNK = 1 << 12;
+    vector<unsigned> key_positions = this->key_positions(key_columns);
+    size_t n_rows = this->n_rows();
+    vector<uint64_t> chunk_hashes((n_rows + CHUNK - 1) / CHUNK);
+    parallel_for(0, chunk_hashes.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; c++) {
+            uint64_t hash = FNV_OFFSET;
+            size_t end = min(n_rows, (c + 1) * CHUNK);
+            for (size_t r = c * CHUNK; r < end; r++) {
+                Row* row = this->row(r);
+                for (unsigned position : key_positions) {
+                    hash = fnv_add(hash, row->at(position));
+                }
+                Row::reclaim(row);
+            }
+            chunk_hashes.at(c) = hash;
+        }
+    });
+    uint64_t fingerprint = FNV_OFFSET;
+    for (uint64_t hash : chunk_hashes) {
+        fingerprint = (fingerprint ^ hash) * FNV_PRIME;
+    }
+    return fingerprint;
+}
+
+// Extend the zones with the n rows just added at positions first_row on. Whole new zones are computed in parallel.
+void Table::update_zones(size_t first_row, Row* const* rows, size_t n)
+{
+    size_t n_columns = _columns.size();
+    size_t first_zone = first_row / ZONE_ROWS;
+    size_t end_row = first_row + n;
+    _zones.resize((end_row + ZONE_ROWS - 1) / ZONE_ROWS);
+    parallel_for(first_zone, _zones.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t z = lo; z < hi; z++) {
+            Zone& zone = _zones.at(z);
+            size_t begin = max(first_row, z * ZONE_ROWS);
+            size_t end = min(end_row, (z + 1) * ZONE_ROWS);
+            if (zone.min.empty()) {
+                zone.min = *rows[begin - first_row];
+                zone.max = zone.min;
+                begin++;
+            }
+            for (size_t r = begin; r < end; r++) {
+                const Row* row = rows[r - first_row];
+                for (size_t c = 0; c < n_columns; c++) {
+                    const string& value = row->at(c);
+                    if (value < zone.min[c]) {
+                        zone.min[c] = value;
+                    } else if (value > zone.max[c]) {
+                        zone.max[c] = value;
+                    }
+                }
+            }
+        }
+    });
+}
+
+// Encode each row as a record, (the varint length and bytes of each value), and append the records to the last
+// page, starting a new page whenever the current one is full.
+void Table::append_to_pages(Row* const* rows, size_t n)
+{
+    auto new_page = [this]() {
+        PageId page_id = _pool->allocate();
+        char* page = _pool->pin(page_id);
+        _pool->unpin(page_id, false);
+        SlottedPage::init(page);
+        _pages.emplace_back(page_id);
+        _page_ends.emplace_back(n_rows());
+        return page;
+    };
+    PageId page_id;
+    char* page;
+    if (_pages.empty()) {
+        page = new_page();
+    } else {
+        page = _pool->pin(_pages.back());
+    }
+    page_id = _pages.back();
+    string record;
+    for (size_t i = 0; i < n;) {
+        encode_record(rows[i], record);
+        if (SlottedPage::insert(page, record.data(), record.size()) >= 0) {
+            _page_ends.back()++;
+            i++;
+        } else {
+            _pool->unpin(page_id, true);
+            page = new_page();
+            page_id = _pages.back();
+        }
+    }
+    _pool->unpin(page_id, true);
+}
+
+void Table::check_record_size(const Row* row) const
+{
+    string record;
+    encode_record(row, record);
+    if (record.size() > SlottedPage::max_record_size()) {
+        throw TableException("Row is too large for a page");
+    }
+}
+
+void Table::log_to(WriteAheadLog* log)
+{
+    _log = log;
+}
+
+vector<unsigned> Table::key_positions(const ColumnNames& key_columns) const
+{
+    vector<unsigned> positions;
+    for (const string& column : key_columns) {
+        int position = _columns.position(column);
+        assert(position != -1);
+        positions.emplace_back((unsigned) position);
+    }
+    return positions;
+}
+
+void Table::check_row(const Row* row) const
+{
+    const ColumnNames& source_columns = row->table()->columns();
+    const ColumnNames& target_columns = _columns;
+    if (row->size() != _columns.size()) {
+        throw TableException("row size is wrong");
+    }
+    if (source_columns.size() != target_columns.size()) {
+        throw TableException("source and target metadata incompatible");
+    }
+}
+
+Table::Table(const string &name, const ColumnNames &columns, BufferPool* pool)
     : _name(name),
-      _columns(columns)
+      _columns(columns),
+      _version(0),
+      _log(NULL),
+      _statistics(NULL),
+      _pool(pool)
 {
     if (columns.empty()) {
         throw TableException("No columns");
@@ -77,6 +428,7 @@ Table::Table(const string &name, const ColumnNames &columns)
 
 Table::~Table()
 {
+    delete _statistics;
     for (Index* index : _indexes) {
         delete index;
     }
@@ -1,46 +1,118 @@
 #ifndef TABLE_H
 #define TABLE_H
 
+#include <cstdint>
 #include <memory>
 #include <set>
 #include "Row.h"
 #include "ColumnNames.h"
+#include "BufferPool.h"
 
 using namespace std;
 
 class Index;
+class TableStatistics;
+class WriteAheadLog;
+
+// The smallest and largest value of each column, (as compared by strcmp), over a block of consecutive rows of a
+// table.
+struct Zone
+{
+    vector<string> min;
+    vector<string> max;
+};
 
 class Table
 {
 public:
+    // The number of rows per zone. Zone i covers rows [i * ZONE_ROWS, (i + 1) * ZONE_ROWS).
+    static const size_t ZONE_ROWS = 1024;
+
     // The name of this Table
     const string &name() const;
 
     // The columns of this Table
     const ColumnNames &columns() const;
 
-    // The contents of this Table
+    // The contents of this Table. Always empty for a paged table, (use n_rows and row instead).
     RowList& rows();
 
+    // The number of rows
+    size_t n_rows() const;
+
+    // True if the rows of this table are stored in the pages of a BufferPool, rather than held in memory
+    bool paged() const;
+
+    // The row at the given position. For a table held in memory, this is the table's own row. For a paged table,
+    // it is a new intermediate row, read through the buffer pool. Either way, the caller is done with it by calling
+    // Row::reclaim.
+    Row* row(size_t position) const;
+
     // Add the given row to the table, returning true if the row was added, false if not (because a matching row
     // is already present). Following a successful add (i.e., returning true), the row is owned by the table, and
     // must not be modified or deleted by the caller. Otherwise, it is the caller's responsibility to delete the row
     // eventually.
     void add(Row* row);
 
+    // Add the given rows, in order, as if by calling add for each of them. The rows are checked before any of them
+    // is added, so that either all of them are added, or none (and TableException is thrown).
+    void add_all(const RowList& rows);
+
     Index* add_index(const ColumnNames& index_columns);
 
-    // Create a table with the given name and column names
-    Table(const string& name, const ColumnNames& columns);
+    // The indexes added by add_index and open_index. An index is not updated by later changes to the table.
+    const vector<Index*>& indexes() const;
+
+    // Reopen an index written by Index::save, adding it to this table's indexes. The index is trusted only if the
+    // file was written for a table with this name, version, and number of rows, and if the fingerprint of the key
+    // values still matches. Otherwise, the index is stale and NULL is returned, (so the caller should use add_index
+    // instead). Throws TableException if the file can't be read, or is not an index file.
+    Index* open_index(const string& path);
+
+    // The zones of this table, covering all rows, kept up to date by add and add_all.
+    const vector<Zone>& zones() const;
+
+    // Incremented by every change to the contents of this table
+    unsigned long version() const;
+
+    // The statistics computed by analyze, (see Statistics.h), or NULL if the table hasn't been analyzed
+    const TableStatistics* statistics() const;
+
+    // A hash of the values of the given columns of all rows, in row order
+    uint64_t key_fingerprint(const ColumnNames& key_columns) const;
+
+    // Append a record of each further add and add_all to log, once the rows are stored, (NULL to stop logging).
+    // Used by Database when logging is enabled.
+    void log_to(WriteAheadLog* log);
+
+    // Create a table with the given name and column names. If pool is not NULL, the table is paged: added rows are
+    // written to slotted pages allocated from the pool, (and then deleted), and are read back through the pool.
+    Table(const string& name, const ColumnNames& columns, BufferPool* pool = NULL);
 
     // Destroy this table
     ~Table();
 
+private:
+    friend const TableStatistics* analyze(Table* table);
+
+    void check_row(const Row* row) const;
+    vector<unsigned> key_positions(const ColumnNames& key_columns) const;
+    void update_zones(size_t first_row, Row* const* rows, size_t n);
+    void append_to_pages(Row* const* rows, size_t n);
+    void check_record_size(const Row* row) const;
+
 private:
     string _name;
     ColumnNames _columns;
     RowList _rows;
     vector<Index*> _indexes;
+    vector<Zone> _zones;
+    unsigned long _version;
+    WriteAheadLog* _log;
+    TableStatistics* _statistics;
+    BufferPool* _pool;
+    vector<PageId> _pages;          // The pages of a paged table, in row order
+    vector<size_t> _page_ends;      // For each page, the position following its last row
 };
 
 
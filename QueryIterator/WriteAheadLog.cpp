@@ -0,0 +1,320 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "WriteAheadLog.h"
+#include "BinaryFormat.h"
+#include "Database.h"
+#include "MappedFile.h"
+
+static const char LOG_MAGIC[8] = {'Q', 'I', 'R', 'E', 'D', 'O', 'L', 'G'};
+static const uint32_t LOG_VERSION = 1;
+static const size_t LOG_HEADER_SIZE = sizeof(LOG_MAGIC) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+enum RecordType : char
+{
+    NEW_TABLE = 1,
+    ADD_ROWS = 2
+};
+
+// New table flags
+static const uint64_t PAGED = 1;
+
+// Appending waits for the flusher once this much is buffered.
+static const size_t MAX_BUFFERED_BYTES = 64 << 20;
+
+//----------------------------------------------------------------------
+
+// Encoding
+
+static uint32_t checksum(const char* data, size_t n)
+{
+    // 32-bit FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void put_varint(string& out, uint64_t x)
+{
+    while (x >= 0x80) {
+        out += (char) (x | 0x80);
+        x >>= 7;
+    }
+    out += (char) x;
+}
+
+static void put_string(string& out, const string& s)
+{
+    put_varint(out, s.size());
+    out += s;
+}
+
+// Reads the fields of a record payload, throwing TableException on reading past its end.
+class PayloadReader
+{
+public:
+    uint64_t varint()
+    {
+        uint64_t x = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            unsigned char byte = (unsigned char) *_reader.take(1);
+            x |= (uint64_t) (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return x;
+            }
+        }
+        throw TableException("Corrupt log record");
+    }
+
+    string str()
+    {
+        uint64_t n = varint();
+        if (n > _reader.remaining()) {
+            throw TableException("Corrupt log record");
+        }
+        return string(_reader.take(n), n);
+    }
+
+    char type()
+    {
+        return *_reader.take(1);
+    }
+
+    bool done() const
+    {
+        return _reader.remaining() == 0;
+    }
+
+    PayloadReader(const char* start, size_t size)
+        : _reader(start, size)
+    {}
+
+private:
+    BinaryReader _reader;
+};
+
+//----------------------------------------------------------------------
+
+// WriteAheadLog
+
+const string& WriteAheadLog::path() const
+{
+    return _path;
+}
+
+uint64_t WriteAheadLog::sequence() const
+{
+    return _sequence;
+}
+
+void WriteAheadLog::log_new_table(const string& name, const ColumnNames& columns, bool paged)
+{
+    string payload;
+    payload += (char) NEW_TABLE;
+    put_string(payload, name);
+    put_varint(payload, columns.size());
+    for (const string& column : columns) {
+        put_string(payload, column);
+    }
+    put_varint(payload, paged ? PAGED : 0);
+    append_record(payload);
+}
+
+void WriteAheadLog::log_rows(const string& table_name, Row* const* rows, size_t n)
+{
+    // Reused, so that logging a row usually doesn't allocate.
+    static thread_local string payload;
+    payload.clear();
+    payload += (char) ADD_ROWS;
+    put_string(payload, table_name);
+    put_varint(payload, n);
+    for (size_t i = 0; i < n; i++) {
+        for (const string& value : *rows[i]) {
+            put_string(payload, value);
+        }
+    }
+    append_record(payload);
+}
+
+void WriteAheadLog::sync()
+{
+    unique_lock<mutex> lock(_lock);
+    uint64_t target = _appended_bytes;
+    _flushed.wait(lock, [this, target] { return _durable_bytes >= target || !_error.empty(); });
+    if (!_error.empty()) {
+        throw TableException(_error);
+    }
+}
+
+void WriteAheadLog::append_record(const string& payload)
+{
+    unique_lock<mutex> lock(_lock);
+    _flushed.wait(lock, [this] { return _buffer.size() < MAX_BUFFERED_BYTES || !_error.empty(); });
+    if (!_error.empty()) {
+        throw TableException(_error);
+    }
+    uint32_t header[2] = {(uint32_t) payload.size(), checksum(payload.data(), payload.size())};
+    bool was_empty = _buffer.empty();
+    _buffer.append((const char*) header, sizeof(header));
+    _buffer.append(payload);
+    _appended_bytes += sizeof(header) + payload.size();
+    // The flusher only waits for an empty buffer to fill. Otherwise it is busy, and will find this record.
+    if (was_empty) {
+        _appended.notify_one();
+    }
+}
+
+// The flusher thread: write whatever has been appended, fsync, and repeat.
+void WriteAheadLog::flush()
+{
+    string batch;
+    unique_lock<mutex> lock(_lock);
+    while (true) {
+        _appended.wait(lock, [this] { return !_buffer.empty() || _stopping; });
+        if (_buffer.empty()) {
+            return;
+        }
+        batch.clear();
+        swap(batch, _buffer);
+        uint64_t target = _appended_bytes;
+        lock.unlock();
+        // Records appended from here on go to the next batch.
+        bool ok = true;
+        for (size_t written = 0; ok && written < batch.size();) {
+            ssize_t n = write(_fd, batch.data() + written, batch.size() - written);
+            ok = n > 0;
+            written += ok ? n : 0;
+        }
+        ok = ok && fdatasync(_fd) == 0;
+        lock.lock();
+        if (ok) {
+            _durable_bytes = target;
+        } else {
+            _error = "Can't write " + _path;
+            _buffer.clear();
+        }
+        _flushed.notify_all();
+        if (!ok) {
+            return;
+        }
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const string& path, uint64_t sequence, size_t valid_bytes)
+    : _path(path),
+      _sequence(sequence),
+      _fd(-1),
+      _appended_bytes(0),
+      _durable_bytes(0),
+      _stopping(false)
+{
+    if (valid_bytes == 0) {
+        // Replace any existing log atomically, so that a crash leaves either the old log or the new one.
+        BinaryWriter writer(path);
+        writer.bytes(LOG_MAGIC, sizeof(LOG_MAGIC));
+        writer.u32(LOG_VERSION);
+        writer.u32(BYTE_ORDER_MARK);
+        writer.u64(sequence);
+        writer.commit();
+        valid_bytes = LOG_HEADER_SIZE;
+    }
+    _fd = open(path.c_str(), O_WRONLY);
+    if (_fd < 0) {
+        throw TableException("Can't open " + path);
+    }
+    // Drop the tail of a write interrupted by a crash, so that new records follow the intact ones.
+    if (ftruncate(_fd, (off_t) valid_bytes) != 0 || lseek(_fd, 0, SEEK_END) < 0) {
+        close(_fd);
+        throw TableException("Can't open " + path);
+    }
+    _flusher = thread(&WriteAheadLog::flush, this);
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    {
+        lock_guard<mutex> lock(_lock);
+        _stopping = true;
+    }
+    _appended.notify_one();
+    _flusher.join();
+    close(_fd);
+}
+
+size_t WriteAheadLog::replay(const string& path, uint64_t sequence, BufferPool* pool)
+{
+    MappedFile file(path);
+    BinaryReader reader(file.data(), file.size());
+    if (file.size() < LOG_HEADER_SIZE ||
+        memcmp(reader.take(sizeof(LOG_MAGIC)), LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) {
+        throw TableException(path + " is not a log");
+    }
+    if (reader.u32() != LOG_VERSION) {
+        throw TableException("Unsupported log version");
+    }
+    if (reader.u32() != BYTE_ORDER_MARK) {
+        throw TableException("Log was written with a different byte order");
+    }
+    uint64_t log_sequence = reader.u64();
+    if (log_sequence > sequence) {
+        throw TableException("Log " + path + " is newer than the snapshot");
+    }
+    if (log_sequence < sequence) {
+        return 0;
+    }
+    size_t valid_bytes = LOG_HEADER_SIZE;
+    while (reader.remaining() >= 2 * sizeof(uint32_t)) {
+        uint32_t size = reader.u32();
+        uint32_t expected_checksum = reader.u32();
+        if (size > reader.remaining()) {
+            break;
+        }
+        const char* payload = reader.take(size);
+        if (checksum(payload, size) != expected_checksum) {
+            break;
+        }
+        PayloadReader fields(payload, size);
+        char type = fields.type();
+        string name = fields.str();
+        if (type == NEW_TABLE) {
+            ColumnNames columns({});
+            for (uint64_t n = fields.varint(); n > 0; n--) {
+                columns.emplace_back(fields.str());
+            }
+            uint64_t flags = fields.done() ? 0 : fields.varint();
+            Database::new_table(name, columns, (flags & PAGED) ? pool : NULL);
+        } else if (type == ADD_ROWS) {
+            Table* table = Database::table(name);
+            if (table == NULL) {
+                throw TableException("Log adds rows to unknown table " + name);
+            }
+            size_t n_columns = table->columns().size();
+            RowList rows;
+            try {
+                for (uint64_t n = fields.varint(); n > 0; n--) {
+                    Row* row = new Row(table);
+                    rows.emplace_back(row);
+                    row->reserve(n_columns);
+                    for (size_t c = 0; c < n_columns; c++) {
+                        row->emplace_back(fields.str());
+                    }
+                }
+                table->add_all(rows);
+            } catch (TableException& e) {
+                for (Row* row : rows) {
+                    delete row;
+                }
+                throw;
+            }
+        } else {
+            throw TableException("Corrupt log record");
+        }
+        if (!fields.done()) {
+            throw TableException("Corrupt log record");
+        }
+        valid_bytes = file.size() - reader.remaining();
+    }
+    return valid_bytes;
+}
@@ -0,0 +1,94 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ColumnNames.h"
+#include "Row.h"
+
+using namespace std;
+
+class BufferPool;
+
+/*
+ * A redo log of changes to the Database, (new tables, and rows added to tables), for recovering the changes made
+ * since the last snapshot. A log file contains:
+ *
+ *     header:   magic "QIREDOLG", u32 format version, u32 byte order mark (0x01020304), u64 sequence number
+ *     records:  u32 payload length, u32 checksum of the payload, payload
+ *
+ * A payload is a record type byte followed by varint-encoded fields:
+ *
+ *     new table:  name, number of columns, column names, flags (1 if the table's rows are stored in pages)
+ *     add rows:   table name, number of rows, then the values of each row, in column order
+ *
+ * where a string is its varint length followed by its bytes. Flags are absent in logs written before they were
+ * added, and taken to be 0. The sequence number identifies the snapshot the log
+ * continues from: Database::checkpoint saves a snapshot with the next sequence number, and then starts a new, empty
+ * log with that number. A log whose number is older than the snapshot's was already folded into the snapshot.
+ *
+ * Appending a record only encodes it into a buffer. A flusher thread writes the buffer and fsyncs the file, and
+ * records appended while it does so are written by its next write, so under a high ingest rate, a single fsync
+ * covers many records (group commit). sync() waits for everything appended so far to be durable.
+ */
+class WriteAheadLog
+{
+public:
+    const string& path() const;
+
+    uint64_t sequence() const;
+
+    // Append a record of a new table. paged indicates that its rows are stored in pages of a BufferPool.
+    void log_new_table(const string& name, const ColumnNames& columns, bool paged);
+
+    // Append a record of n rows added to the named table.
+    void log_rows(const string& table_name, Row* const* rows, size_t n);
+
+    // Wait until all records appended so far have been written and fsynced.
+    void sync();
+
+    // Append to the log file at path, whose first valid_bytes bytes are intact, (as returned by replay), and which
+    // has the given sequence number. If valid_bytes is 0, the file is replaced by an empty log. Throws
+    // TableException if the file can't be opened or created. Methods appending records, and sync, throw
+    // TableException if writing the log has failed.
+    WriteAheadLog(const string& path, uint64_t sequence, size_t valid_bytes = 0);
+
+    // Write and fsync the records appended so far, and stop the flusher thread.
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+public:
+    // Apply the records of the log at path to the Database: tables are created with Database::new_table, (paged
+    // tables in pool's pages, or in memory if pool is NULL), and rows added with Table::add_all. If the log's sequence number is older than sequence, its records are already in
+    // the snapshot, and nothing is applied. Replay stops at the first incomplete record, or record whose checksum
+    // doesn't match, (the tail of a write interrupted by a crash). Returns the number of bytes of the file up to
+    // that point, for passing to the constructor, or 0 if nothing in the file should be kept. Throws
+    // TableException if the file can't be read, is not a log, or has a sequence number newer than sequence,
+    // (i.e., the matching snapshot is missing).
+    static size_t replay(const string& path, uint64_t sequence, BufferPool* pool = NULL);
+
+private:
+    void append_record(const string& payload);
+    void flush();
+
+private:
+    string _path;
+    uint64_t _sequence;
+    int _fd;
+    thread _flusher;
+    mutex _lock;                        // Protects the members below
+    condition_variable _appended;
+    condition_variable _flushed;
+    string _buffer;                     // Records appended but not yet written
+    uint64_t _appended_bytes;           // Bytes of records appended since the log was opened
+    uint64_t _durable_bytes;            // How many of those have been written and fsynced
+    string _error;                      // Set if a write failed, after which nothing more is appended
+    bool _stopping;
+};
+
+#endif //WRITEAHEADLOG_H
@@ -1,8 +1,12 @@
 void test_operators(int argc, const char** argv);
 void test_queries(int argc, const char** argv);
+void test_scheduler(int argc, const char** argv);
+void test_storage(int argc, const char** argv);
 
 int main(int argc, const char** argv)
 {
     test_operators(argc, argv);
     test_queries(argc, argv);
+    test_scheduler(argc, argv);
+    test_storage(argc, argv);
 }
@@ -1,6 +1,12 @@
 #include <fstream>
 #include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Database.h"
+#include "Operators.h"
+#include "Statistics.h"
 #include "unittest.h"
 #include "util.h"
 
@@ -75,6 +81,82 @@ void table_scan_non_empty()
 
 //----------------------------------------------------------------------------------------------------------------------
 
+// Column handles
+
+void column_handle()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    add(t, {"1", "2"});
+    ColumnHandle b(t->columns(), "b");
+    CHECK(b.position() == 1);
+    Row* row = t->rows().at(0);
+    CHECK(row->value(b) == "2");
+    CHECK(row->value("b") == "2");
+    // Handles work for intermediate rows too.
+    Row intermediate({"3", "4"});
+    CHECK(intermediate.value(b) == "4");
+    bool thrown = false;
+    try {
+        ColumnHandle(t->columns(), "c");
+    } catch (RowException& e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// analyze
+
+void table_statistics()
+{
+    Table* t = Database::new_table("t", ColumnNames{"id", "color"});
+    CHECK(t->statistics() == NULL);
+    const char* colors[] = {"red", "red", "red", "green", "green", "blue"};
+    for (int i = 0; i < 1200; i++) {
+        add(t, {to_string(100000 + i), colors[i % 6]});
+    }
+    const TableStatistics* statistics = analyze(t);
+    CHECK(t->statistics() == statistics);
+    CHECK(statistics->n_rows() == 1200);
+    const ColumnStatistics& id = statistics->column("id");
+    CHECK(id.min() == "100000" && id.max() == "101199");
+    CHECK(fabs(id.n_distinct() - 1200) < 60);
+    CHECK(id.most_common().empty());
+    CHECK(id.histogram().size() == 16);
+    for (const HistogramBucket& bucket : id.histogram()) {
+        CHECK(bucket.n_rows == 75);
+    }
+    CHECK(fabs(id.selectivity("100000", "100599") - 0.5) < 0.05);
+    CHECK(id.selectivity("2", "3") == 0);
+    const ColumnStatistics& color = statistics->column(1);
+    CHECK(fabs(color.n_distinct() - 3) < 0.1);
+    CHECK(color.most_common().size() == 3);
+    CHECK(color.most_common().at(0) == make_pair(string("red"), (size_t) 600));
+    CHECK(fabs(color.selectivity("green", "green") - 1.0 / 3) < 1e-9);
+    // Added rows are counted as they are added.
+    add(t, {"200000", "purple"});
+    add(t, {"200001", "red"});
+    CHECK(statistics->n_rows() == 1202);
+    CHECK(id.max() == "200001");
+    CHECK(color.most_common().at(0).second == 601);
+    CHECK(fabs(color.n_distinct() - 4) < 0.1);
+    size_t n_rows = 0;
+    for (const HistogramBucket& bucket : color.histogram()) {
+        n_rows += bucket.n_rows;
+    }
+    CHECK(n_rows == 1202);
+    bool thrown = false;
+    try {
+        statistics->column("size");
+    } catch (TableException& e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 // index_scan
 
 void index_scan_empty()
@@ -132,6 +214,22 @@ void index_scan_non_empty()
     delete control_iterator;
 }
 
+void index_build_large()
+{
+    // Enough rows for a parallel build, with duplicate keys: the index must match one built row by row.
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    for (unsigned k = 0; k < 100000; k++) {
+        add(t, {to_string((k * 7919) % 30011), to_string(k)});
+    }
+    Index* built = t->add_index(ColumnNames{"a"});
+    Index control(t, ColumnNames{"a"});
+    for (Row* row : t->rows()) {
+        control.put({row->at(0)}, row);
+    }
+    CHECK(built->size() == control.size());
+    CHECK(equal(built->begin(), built->end(), control.begin()));
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 // select
@@ -352,6 +450,73 @@ void nested_loops_both_non_empty()
 
 //----------------------------------------------------------------------------------------------------------------------
 
+// bloom_join
+
+void bloom_join_empty()
+{
+    Table* r = Database::new_table("r", ColumnNames{"a", "b", "c"});
+    Table* s = Database::new_table("s", ColumnNames{"c", "d", "e"});
+    Iterator* i = bloom_join(table_scan(r), {2}, table_scan(s), {0});
+    CHECK(i->n_columns() == 5);
+    TWICE {
+        i->open();
+        Row* row = i->next();
+        CHECK(row == NULL);
+        row = i->next();
+        CHECK(row == NULL);
+        i->close();
+    };
+    delete i;
+}
+
+void bloom_join_no_next()
+{
+    Table* r = Database::new_table("r", ColumnNames{"a", "b", "c"});
+    add(r, {"1", "2", "a"});
+    Table* s = Database::new_table("s", ColumnNames{"c", "d", "e"});
+    add(s, {"a", "12", "1"});
+    Iterator* i = bloom_join(table_scan(r), {2}, table_scan(s), {0});
+    TWICE {
+        i->open();
+        i->close();
+    };
+    delete i;
+}
+
+void bloom_join_both_non_empty()
+{
+    Table* r = Database::new_table("r", ColumnNames{"a", "b", "c"});
+    add(r, {"1", "2", "a"});
+    add(r, {"3", "4", "b"});
+    add(r, {"5", "6", "c"});
+    add(r, {"7", "8", "a"});
+    Table* s = Database::new_table("s", ColumnNames{"c", "d", "e"});
+    add(s, {"a", "12", "1"});
+    add(s, {"c", "56", "1"});
+    add(s, {"a", "12", "2"});
+    add(s, {"c", "56", "2"});
+    add(s, {"c", "56", "3"});
+    add(s, {"d", "--", "-"});
+    for (unsigned i = 0; i < 1000; i++) {
+        add(s, {"x" + to_string(i), "--", "-"});
+    }
+    Iterator* i = bloom_join(table_scan(r), {2}, table_scan(s), {0});
+    Iterator* control_iterator = nested_loops_join(table_scan(r), {2}, table_scan(s), {0});
+    CHECK(i->n_columns() == 5);
+    TWICE {
+        CHECK(match(control_iterator, i));
+        // Most rows that can't join are filtered out.
+        BloomJoin* join = dynamic_cast<BloomJoin*>(i);
+        CHECK(join->n_probe_rows() == s->rows().size());
+        CHECK(join->n_probe_rows_passed() >= 5);
+        CHECK(join->n_probe_rows_passed() < 50);
+    };
+    delete i;
+    delete control_iterator;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 // sort
 
 void sort_empty()
@@ -471,15 +636,415 @@ void unique_non_empty()
 
 //----------------------------------------------------------------------------------------------------------------------
 
+// pipeline_break
+
+void pipeline_break_empty()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    Iterator* i = pipeline_break(table_scan(t));
+    CHECK(i->n_columns() == 2);
+    TWICE {
+        i->open();
+        Row* row = i->next();
+        CHECK(row == NULL);
+        row = i->next();
+        CHECK(row == NULL);
+        i->close();
+    };
+    delete i;
+}
+
+void pipeline_break_no_next()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    add(t, {"1", "10"});
+    add(t, {"2", "20"});
+    Iterator* i = pipeline_break(table_scan(t), 1);
+    CHECK(i->n_columns() == 2);
+    TWICE {
+        i->open();
+        i->close();
+    };
+    delete i;
+}
+
+void pipeline_break_non_empty()
+{
+    Table* r = Database::new_table("r", ColumnNames{"a", "b", "c"});
+    add(r, {"1", "2", "a"});
+    add(r, {"3", "4", "b"});
+    add(r, {"5", "6", "c"});
+    Table* s = Database::new_table("s", ColumnNames{"c", "d", "e"});
+    add(s, {"a", "12", "1"});
+    add(s, {"a", "12", "2"});
+    add(s, {"c", "56", "1"});
+    add(s, {"c", "56", "2"});
+    add(s, {"c", "56", "3"});
+    add(s, {"d", "--", "-"});
+    // A batch size of 2 forces several hand-offs, including a partial final batch.
+    Iterator* i = project(pipeline_break(nested_loops_join(table_scan(r), {2}, table_scan(s), {0}), 2), {0, 4});
+    Table* control = Database::new_table("control", {"a", "e"});
+    add(control, {"1", "1"});
+    add(control, {"1", "2"});
+    add(control, {"5", "1"});
+    add(control, {"5", "2"});
+    add(control, {"5", "3"});
+    Iterator* control_iterator = table_scan(control);
+    CHECK(i->n_columns() == 2);
+    TWICE {
+        CHECK(match(control_iterator, i));
+    };
+    delete i;
+    delete control_iterator;
+}
+
+void pipeline_break_early_close()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a"});
+    for (unsigned k = 0; k < 10000; k++) {
+        add(t, {to_string(k)});
+    }
+    Iterator* i = pipeline_break(project(table_scan(t), {0}), 4);
+    TWICE {
+        i->open();
+        Row* row = i->next();
+        CHECK(row->at(0) == "0");
+        done_with(row);
+        i->close();
+    };
+    delete i;
+}
+
+void pipeline_break_reopen()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a"});
+    for (unsigned k = 0; k < 100; k++) {
+        add(t, {to_string(k)});
+    }
+    Iterator* i = pipeline_break(table_scan(t), 4);
+    i->open();
+    done_with(i->next());
+    // Opened again, without a close
+    i->open();
+    unsigned n_rows = 0;
+    for (Row* row = i->next(); row != NULL; row = i->next()) {
+        n_rows++;
+        done_with(row);
+    }
+    CHECK(n_rows == 100);
+    i->close();
+    delete i;
+}
+
+// Passes on the rows of its input until it has passed on n of them, and then throws.
+class FailingScan : public Iterator
+{
+public:
+    unsigned n_columns() override
+    {
+        return _input->n_columns();
+    }
+
+    void open() override
+    {
+        _input->open();
+        _n_passed = 0;
+        _open = true;
+    }
+
+    Row* next() override
+    {
+        if (_n_passed == _n) {
+            throw TableException("input failed");
+        }
+        _n_passed++;
+        return _input->next();
+    }
+
+    void close() override
+    {
+        _input->close();
+        _open = false;
+    }
+
+    FailingScan(Table* table, unsigned n)
+        : _input(table_scan(table)),
+          _n(n),
+          _n_passed(0),
+          _open(false)
+    {}
+
+    ~FailingScan()
+    {
+        delete _input;
+    }
+
+    bool is_open() const
+    {
+        return _open;
+    }
+
+private:
+    Iterator* _input;
+    unsigned _n;
+    unsigned _n_passed;
+    bool _open;
+};
+
+void pipeline_break_input_fails()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a"});
+    for (unsigned k = 0; k < 10; k++) {
+        add(t, {to_string(k)});
+    }
+    FailingScan* input = new FailingScan(t, 5);
+    Iterator* i = pipeline_break(input, 2);
+    TWICE {
+        i->open();
+        unsigned n_rows = 0;
+        bool failed = false;
+        try {
+            for (Row* row = i->next(); row != NULL; row = i->next()) {
+                n_rows++;
+                done_with(row);
+            }
+        } catch (TableException& e) {
+            failed = true;
+        }
+        CHECK(failed);
+        CHECK(n_rows == 4);
+        // The input was closed by the producer, when it failed.
+        CHECK(!input->is_open());
+        i->close();
+    };
+    delete i;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// csv_scan
+
+static void write_file(const char* path, const char* contents)
+{
+    FILE* file = fopen(path, "w");
+    fputs(contents, file);
+    fclose(file);
+}
+
+void csv_scan_empty()
+{
+    const char* path = "csv_scan_empty.csv";
+    write_file(path, "");
+    Iterator* i = csv_scan(path, ColumnNames{"a", "b"});
+    CHECK(i->n_columns() == 2);
+    TWICE {
+        i->open();
+        Row* row = i->next();
+        CHECK(row == NULL);
+        row = i->next();
+        CHECK(row == NULL);
+        i->close();
+    };
+    delete i;
+    remove(path);
+}
+
+void csv_scan_no_next()
+{
+    const char* path = "csv_scan_no_next.csv";
+    write_file(path, "\"1\",\"2\"\n");
+    Iterator* i = csv_scan(path, ColumnNames{"a", "b"});
+    CHECK(i->n_columns() == 2);
+    TWICE {
+        i->open();
+        i->close();
+    };
+    delete i;
+    remove(path);
+}
+
+void csv_scan_non_empty()
+{
+    const char* path = "csv_scan_non_empty.csv";
+    // The last line has no newline, and a 4-byte buffer has to grow to hold the longer lines.
+    write_file(path, "\"1\",\"a much longer value\"\r\n\n\"3\",\"4\"\n5,\"x,y\"");
+    Iterator* i = csv_scan(path, ColumnNames{"a", "b"}, 4);
+    Table* control = Database::new_table("control", ColumnNames{"a", "b"});
+    add(control, {"1", "a much longer value"});
+    add(control, {"3", "4"});
+    add(control, {"5", "x,y"});
+    Iterator* control_iterator = table_scan(control);
+    CHECK(i->n_columns() == 2);
+    TWICE {
+        CHECK(match(control_iterator, i));
+    };
+    delete i;
+    delete control_iterator;
+    remove(path);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// zone_scan
+
+void zone_scan_empty()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a"});
+    Iterator* i = zone_scan(t, {{0, "a", "z"}});
+    CHECK(i->n_columns() == 1);
+    TWICE {
+        i->open();
+        Row* row = i->next();
+        CHECK(row == NULL);
+        row = i->next();
+        CHECK(row == NULL);
+        i->close();
+    };
+    delete i;
+}
+
+// Check a zone scan against a selection of the same rows, and return the number of zones scanned.
+static unsigned long check_zone_scan(Table* t, const vector<ColumnRange>& ranges)
+{
+    Iterator* i = zone_scan(t, ranges);
+    static unsigned n_controls = 0;
+    Table* control = Database::new_table("control" + to_string(n_controls++), t->columns());
+    for (Row* row : t->rows()) {
+        bool matches = true;
+        for (const ColumnRange& range : ranges) {
+            matches = matches && range.lo <= row->at(range.column) && row->at(range.column) <= range.hi;
+        }
+        if (matches) {
+            add(control, *row);
+        }
+    }
+    Iterator* control_iterator = table_scan(control);
+    TWICE {
+        CHECK(match(control_iterator, i));
+    };
+    unsigned long zones_scanned = dynamic_cast<ZoneScan*>(i)->zones_scanned();
+    delete i;
+    delete control_iterator;
+    return zones_scanned;
+}
+
+void zone_scan_non_empty()
+{
+    // ids in order, and an unclustered column
+    Table* t = Database::new_table("t", ColumnNames{"id", "g"});
+    for (unsigned i = 0; i < 3000; i++) {
+        add(t, {to_string(1000000 + i), to_string(i % 7)});
+    }
+    RowList rows;
+    for (unsigned i = 3000; i < 5000; i++) {
+        rows.emplace_back(new TestRow(t, {to_string(1000000 + i), to_string(i % 7)}));
+    }
+    t->add_all(rows);
+    CHECK(t->zones().size() == 5);
+    CHECK(t->zones().at(1).min == vector<string>({"1001024", "0"}));
+    CHECK(t->zones().at(1).max == vector<string>({"1002047", "6"}));
+    CHECK(t->zones().at(4).max.at(0) == "1004999");
+    CHECK(check_zone_scan(t, {}) == 5);
+    CHECK(check_zone_scan(t, {{0, "1002000", "1002099"}}) == 2);
+    CHECK(check_zone_scan(t, {{0, "1002000", "1002099"}, {1, "3", "3"}}) == 2);
+    CHECK(check_zone_scan(t, {{0, "1004500", "2000000"}}) == 1);
+    CHECK(check_zone_scan(t, {{0, "2000000", "3000000"}}) == 0);
+    CHECK(check_zone_scan(t, {{1, "3", "3"}}) == 5);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// write_iterator
+
+static string read_file(const char* path)
+{
+    ifstream file(path);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+static string write_to_file(Iterator* input, ResultFormat format, bool writer_thread, size_t buffer_size)
+{
+    const char* path = "write_iterator.out";
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    unsigned long n_rows = write_iterator(input, fd, format, writer_thread, buffer_size);
+    close(fd);
+    string contents = read_file(path);
+    remove(path);
+    return n_rows == (unsigned long) count(contents.begin(), contents.end(), '\n') ? contents : "wrong row count";
+}
+
+void write_iterator_empty()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a"});
+    Iterator* i = table_scan(t);
+    TWICE {
+        CHECK(write_to_file(i, TSV, false, 1 << 20) == "");
+        CHECK(write_to_file(i, CSV, true, 1 << 20) == "");
+    };
+    delete i;
+}
+
+void write_iterator_non_empty()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    add(t, {"1", "x"});
+    add(t, {"2", "say \"hi\", twice"});
+    add(t, {"", "3"});
+    Iterator* i = table_scan(t);
+    string tsv = "1\tx\n2\tsay \"hi\", twice\n\t3\n";
+    string csv = "\"1\",\"x\"\n\"2\",\"say \"\"hi\"\", twice\"\n\"\",\"3\"\n";
+    // Small buffers split rows, and values, across writes.
+    for (size_t buffer_size : {1, 5, 1 << 20}) {
+        for (bool writer_thread : {false, true}) {
+            CHECK(write_to_file(i, TSV, writer_thread, buffer_size) == tsv);
+            CHECK(write_to_file(i, CSV, writer_thread, buffer_size) == csv);
+        }
+    }
+    // CSV output can be loaded again.
+    const char* path = "write_iterator.csv";
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    write_iterator(i, fd, CSV, true);
+    close(fd);
+    Table* copy = Database::new_table("copy", ColumnNames{"a", "b"});
+    load_csv(copy, path);
+    Iterator* copy_scan = table_scan(copy);
+    CHECK(match(i, copy_scan));
+    delete copy_scan;
+    delete i;
+    remove(path);
+}
+
+void write_iterator_bad_fd()
+{
+    Table* t = Database::new_table("t", ColumnNames{"a"});
+    add(t, {"1"});
+    Iterator* i = table_scan(t);
+    for (bool writer_thread : {false, true}) {
+        bool thrown = false;
+        try {
+            write_iterator(i, -1, TSV, writer_thread);
+        } catch (TableException& e) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    delete i;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void test_operators(int argc, const char **argv)
 {
     AFTER_TEST(cleanup);
     ADD_TEST(table_scan_empty);
     ADD_TEST(table_scan_no_next);
     ADD_TEST(table_scan_non_empty);
+    ADD_TEST(column_handle);
+    ADD_TEST(table_statistics);
     ADD_TEST(index_scan_empty);
     ADD_TEST(index_scan_no_next);
     ADD_TEST(index_scan_non_empty);
+    ADD_TEST(index_build_large);
     ADD_TEST(select_empty);
     ADD_TEST(select_no_next);
     ADD_TEST(select_non_empty);
@@ -491,11 +1056,28 @@ void test_operators(int argc, const char **argv)
     ADD_TEST(nested_loops_left_empty);
     ADD_TEST(nested_loops_right_empty);
     ADD_TEST(nested_loops_both_non_empty);
+    ADD_TEST(bloom_join_empty);
+    ADD_TEST(bloom_join_no_next);
+    ADD_TEST(bloom_join_both_non_empty);
     ADD_TEST(sort_empty);
     ADD_TEST(sort_no_next);
     ADD_TEST(sort_non_empty);
     ADD_TEST(unique_empty);
     ADD_TEST(unique_no_next);
     ADD_TEST(unique_non_empty);
+    ADD_TEST(csv_scan_empty);
+    ADD_TEST(csv_scan_no_next);
+    ADD_TEST(csv_scan_non_empty);
+    ADD_TEST(pipeline_break_empty);
+    ADD_TEST(pipeline_break_no_next);
+    ADD_TEST(pipeline_break_non_empty);
+    ADD_TEST(pipeline_break_early_close);
+    ADD_TEST(pipeline_break_input_fails);
+    ADD_TEST(pipeline_break_reopen);
+    ADD_TEST(zone_scan_empty);
+    ADD_TEST(zone_scan_non_empty);
+    ADD_TEST(write_iterator_empty);
+    ADD_TEST(write_iterator_non_empty);
+    ADD_TEST(write_iterator_bad_fd);
     RUN_TESTS();
 }
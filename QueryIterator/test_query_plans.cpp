@@ -1,6 +1,8 @@
 #include <fstream>
 #include <cassert>
 #include "Database.h"
+#include "Operators.h"
+#include "Optimizer.h"
 #include "unittest.h"
 #include "util.h"
 
@@ -17,44 +19,16 @@ static Table *message;
 
 // Loading the database from .csv files
 
-static string strip_eol(string line)
-{
-    char c;
-    int remove = 0;
-    while ((c = line.at(line.size() - 1 - remove)) == '\r' || c == '\n') {
-        remove++;
-    }
-    return line.substr(0, line.size() - remove);
-}
-
 static void load_table(Table *table, string db_dir, const string &filename)
 {
     if (db_dir.at(db_dir.size() - 1) != '/') {
         db_dir += '/';
     }
-    string user_path = db_dir + filename;
-    ifstream input(user_path);
-    string line;
-    if (input.is_open()) {
-        while (getline(input, line)) {
-            line = strip_eol(line);
-            vector<string> fields;
-            size_t start_scan = 0;
-            bool done = false;
-            while (!done) {
-                size_t after_field = line.find(',', start_scan + 1);
-                if (after_field == string::npos) {
-                    done = true;
-                    after_field = line.size();
-                }
-                string field = line.substr(start_scan + 1, after_field - 2 - start_scan); // Skips quote marks
-                fields.emplace_back(field);
-                start_scan = after_field + 1;
-            }
-            add(table, fields);
-        }
-    } else {
-        fprintf(stderr, "Can't open %s?!\n", user_path.c_str());
+    string path = db_dir + filename;
+    try {
+        load_csv(table, path);
+    } catch (TableException& e) {
+        fprintf(stderr, "Can't load %s: %s\n", path.c_str(), e.what());
     }
 }
 
@@ -104,6 +78,23 @@ static void test_q1()
     delete c1;
 }
 
+// The same query, straight from user.csv
+
+static void test_q1_csv_scan()
+{
+    Table *control1 = Database::new_table("control1_csv_scan", ColumnNames{"birth_date"});
+    add(control1, {"1984/02/28"});
+    Iterator* q1 =
+        project(
+            select(csv_scan(string(db_dir) + "/user.csv", ColumnNames{"user_id", "username", "birth_date"}),
+                   q1_predicate),
+            {2});
+    Iterator* c1 = table_scan(control1);
+    CHECK(match(c1, q1));
+    delete q1;
+    delete c1;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 // What are the send dates of messages sent by Zyrianyhippy?
@@ -182,6 +173,74 @@ static void test_q2_index_scan()
     delete c2;
 }
 
+static void test_q2_pipelined()
+{
+    Table *control2 = Database::new_table("control2_pipelined", ColumnNames{"send_date"});
+    add(control2, {"2015/01/09"});
+    add(control2, {"2015/04/29"});
+    add(control2, {"2015/12/25"});
+    add(control2, {"2016/01/08"});
+    add(control2, {"2016/02/09"});
+    add(control2, {"2016/02/22"});
+    add(control2, {"2016/03/25"});
+    add(control2, {"2016/04/26"});
+    add(control2, {"2016/09/05"});
+    add(control2, {"2016/10/08"});
+    add(control2, {"2017/01/10"});
+    add(control2, {"2017/06/07"});
+    add(control2, {"2017/08/05"});
+    Iterator* c2 = table_scan(control2);
+	Iterator* q2 =
+		unique(
+			sort(
+				project(
+					pipeline_break(
+						select(
+							nested_loops_join(
+								nested_loops_join(table_scan(user), { 0 }, table_scan(routing), { 0 }), { 4 },
+								table_scan(message), { 0 }),
+							q2_predicate)),
+				{ 5 }), { 0 })
+		); // The joins run on their own thread.
+    CHECK(match(c2, q2));
+    delete q2;
+    delete c2;
+}
+
+static void test_q2_bloom_join()
+{
+    Table *control2 = Database::new_table("control2_bloom_join", ColumnNames{"send_date"});
+    add(control2, {"2015/01/09"});
+    add(control2, {"2015/04/29"});
+    add(control2, {"2015/12/25"});
+    add(control2, {"2016/01/08"});
+    add(control2, {"2016/02/09"});
+    add(control2, {"2016/02/22"});
+    add(control2, {"2016/03/25"});
+    add(control2, {"2016/04/26"});
+    add(control2, {"2016/09/05"});
+    add(control2, {"2016/10/08"});
+    add(control2, {"2017/01/10"});
+    add(control2, {"2017/06/07"});
+    add(control2, {"2017/08/05"});
+    Iterator* c2 = table_scan(control2);
+    Index* tc = user->add_index(ColumnNames{ "username" });
+    Row username({"Zyrianyhippy"});
+    Iterator* user_routing = bloom_join(index_scan(tc, &username), { 0 }, table_scan(routing), { 0 });
+    Iterator* user_routing_message = bloom_join(user_routing, { 4 }, table_scan(message), { 0 });
+    Iterator* q2 = unique(sort(project(user_routing_message, { 5 }), { 0 }));
+    // The filters on user_id and message_id let through just the rows for the one user.
+    CHECK(match(c2, q2));
+    BloomJoin* join = dynamic_cast<BloomJoin*>(user_routing);
+    CHECK(join->n_probe_rows() == routing->rows().size());
+    CHECK(join->n_probe_rows_passed() * 10 < join->n_probe_rows());
+    join = dynamic_cast<BloomJoin*>(user_routing_message);
+    CHECK(join->n_probe_rows() == message->rows().size());
+    CHECK(join->n_probe_rows_passed() * 10 < join->n_probe_rows());
+    delete q2;
+    delete c2;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 // What are the usernames of members who received messages on their birthdays?
@@ -232,6 +291,122 @@ static void test_q4()
     delete c4;
 }
 
+// The same query, stated logically, and planned by the optimizer: the users are looked up by username, and the
+// joins are ordered to start from them.
+
+static void test_q4_optimized()
+{
+    Table *control4 = Database::new_table("control4_optimized", ColumnNames{"send_date"});
+    add(control4, {"2016/12/14"});
+    LogicalPlan plan;
+    plan.scan(message, "m");
+    plan.scan(user, "from");
+    plan.scan(user, "to");
+    plan.scan(routing, "r");
+    plan.where("from.username", "Unguiferous");
+    plan.where("to.username", "Froglet");
+    plan.join("from.user_id", "r.from_user_id");
+    plan.join("r.to_user_id", "to.user_id");
+    plan.join("m.message_id", "r.message_id");
+    plan.project(ColumnNames{"m.send_date"});
+    string explanation;
+    Iterator* q4 = optimize(plan, &explanation);
+    CHECK(explanation.find("index_scan(from.username)") != string::npos);
+    CHECK(explanation.find("index_scan(to.username)") != string::npos);
+    CHECK(explanation.find("table_scan(m)") != string::npos);
+    Iterator* c4 = table_scan(control4);
+    CHECK(match(c4, q4));
+    delete q4;
+    delete c4;
+    bool thrown = false;
+    try {
+        plan.where("from.user_name", "Froglet");
+    } catch (TableException& e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// Without a usable index, (the index on username isn't kept up to date by add), the user is found by a zone scan.
+
+static void test_q2_optimized()
+{
+    Table *control2 = Database::new_table("control2_optimized", ColumnNames{"send_date"});
+    for (const char* date : {"2015/01/09", "2015/04/29", "2015/12/25", "2016/01/08", "2016/02/09", "2016/02/22",
+                             "2016/03/25", "2016/04/26", "2016/09/05", "2016/10/08", "2017/01/10", "2017/06/07",
+                             "2017/08/05"}) {
+        add(control2, {date});
+    }
+    Table* users = Database::new_table("users_optimized", ColumnNames{"user_id", "username", "birth_date"});
+    for (Row* row : user->rows()) {
+        add(users, *row);
+    }
+    users->add_index(ColumnNames{"username"});
+    add(users, {"9999", "Newcomer", "2000/01/01"});
+    LogicalPlan plan;
+    plan.scan(users, "u");
+    plan.scan(routing, "r");
+    plan.scan(message, "m");
+    plan.where("u.username", "Zyrianyhippy");
+    plan.join("u.user_id", "r.from_user_id");
+    plan.join("r.message_id", "m.message_id");
+    plan.project(ColumnNames{"m.send_date"});
+    string explanation;
+    Iterator* q2 = unique(sort(optimize(plan, &explanation), {0}));
+    CHECK(explanation.find("zone_scan(u)") != string::npos);
+    Iterator* c2 = table_scan(control2);
+    CHECK(match(c2, q2));
+    delete q2;
+    delete c2;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Loading with small ranges, (so that most lines straddle a range boundary), must yield the same rows, in order.
+
+static void test_load_csv_ranges()
+{
+    string path = string(db_dir) + "/message.csv";
+    for (size_t range_bytes : {1, 7, 64, 1000}) {
+        Table* loaded = Database::new_table("message_" + to_string(range_bytes),
+                                            ColumnNames{"message_id", "send_date", "text"});
+        CHECK(load_csv(loaded, path, range_bytes) == message->rows().size());
+        Iterator* expected = table_scan(message);
+        Iterator* actual = table_scan(loaded);
+        CHECK(match(expected, actual));
+        delete expected;
+        delete actual;
+    }
+}
+
+static void test_load_csv_quoting()
+{
+    const char* path = "load_csv_quoting.csv";
+    FILE* file = fopen(path, "w");
+    fputs("\"a,b\",\"say \"\"hi\"\"\",plain\r\n\n\"\",,\"x\"\n", file);
+    fclose(file);
+    Table* t = Database::new_table("quoting", ColumnNames{"a", "b", "c"});
+    CHECK(load_csv(t, path, 5) == 2);
+    Table* control = Database::new_table("quoting_control", ColumnNames{"a", "b", "c"});
+    add(control, {"a,b", "say \"hi\"", "plain"});
+    add(control, {"", "", "x"});
+    Iterator* expected = table_scan(control);
+    Iterator* actual = table_scan(t);
+    CHECK(match(expected, actual));
+    delete expected;
+    delete actual;
+    Table* narrow = Database::new_table("quoting_narrow", ColumnNames{"a", "b"});
+    bool thrown = false;
+    try {
+        load_csv(narrow, path);
+    } catch (TableException& e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(narrow->rows().empty());
+    remove(path);
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 void test_queries(int argc, const char **argv)
@@ -244,10 +419,17 @@ void test_queries(int argc, const char **argv)
     BEFORE_ALL_TESTS(setup);
     AFTER_ALL_TESTS(reset_database);
     ADD_TEST(test_q1);
+    ADD_TEST(test_q1_csv_scan);
     ADD_TEST(test_q2_table_scan);
     ADD_TEST(test_q2_index_scan);
+    ADD_TEST(test_q2_pipelined);
+    ADD_TEST(test_q2_bloom_join);
     ADD_TEST(test_q3);
     ADD_TEST(test_q4);
+    ADD_TEST(test_q4_optimized);
+    ADD_TEST(test_q2_optimized);
+    ADD_TEST(test_load_csv_ranges);
+    ADD_TEST(test_load_csv_quoting);
     RUN_TESTS();
     free(db_dir);
 }
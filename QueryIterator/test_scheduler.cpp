@@ -0,0 +1,138 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include "Scheduler.h"
+#include "unittest.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// TaskGroup
+
+void task_group_empty()
+{
+    TaskGroup group;
+    group.wait();
+    group.wait();
+}
+
+void task_group_runs_all()
+{
+    Scheduler scheduler(4);
+    TaskGroup group(scheduler);
+    atomic<unsigned> count(0);
+    for (unsigned i = 0; i < 1000; i++) {
+        group.run([&count] { count++; });
+    }
+    group.wait();
+    CHECK(count == 1000);
+}
+
+void task_group_nested()
+{
+    Scheduler scheduler(2);
+    TaskGroup outer(scheduler);
+    atomic<unsigned> count(0);
+    for (unsigned i = 0; i < 8; i++) {
+        outer.run([&scheduler, &count] {
+            // Waiting inside a worker must not deadlock, even with more groups than workers.
+            TaskGroup inner(scheduler);
+            for (unsigned j = 0; j < 8; j++) {
+                inner.run([&count] { count++; });
+            }
+            inner.wait();
+        });
+    }
+    outer.wait();
+    CHECK(count == 64);
+}
+
+void task_group_exception()
+{
+    Scheduler scheduler(2);
+    TaskGroup group(scheduler);
+    atomic<unsigned> count(0);
+    for (unsigned i = 0; i < 10; i++) {
+        group.run([&count, i] {
+            count++;
+            if (i == 5) {
+                throw runtime_error("task failed");
+            }
+        });
+    }
+    bool thrown = false;
+    try {
+        group.wait();
+    } catch (runtime_error& e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(count == 10);
+}
+
+void task_group_fairness()
+{
+    // One worker, and a group that floods the queue: a second group's task gets a turn long before the flood
+    // drains. (The test doesn't wait for the second group until its task is done, so that the waiting thread
+    // doesn't run the task itself.)
+    Scheduler scheduler(1);
+    TaskGroup flood(scheduler);
+    TaskGroup small(scheduler);
+    atomic<unsigned> flooded(0);
+    atomic<unsigned> flooded_before_small(0);
+    atomic<bool> small_done(false);
+    for (unsigned i = 0; i < 1000; i++) {
+        flood.run([&flooded] {
+            this_thread::sleep_for(chrono::microseconds(20));
+            flooded++;
+        });
+    }
+    // The worker may get through some of the flood while it is being submitted, so only count the flood's tasks
+    // run after the small group's.
+    unsigned flooded_when_submitted = flooded.load();
+    small.run([&flooded, &flooded_before_small, &small_done] {
+        flooded_before_small = flooded.load();
+        small_done = true;
+    });
+    while (!small_done) {
+        this_thread::yield();
+    }
+    small.wait();
+    flood.wait();
+    CHECK(flooded == 1000);
+    CHECK(flooded_before_small - flooded_when_submitted < 10);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// parallel_for
+
+void parallel_for_covers_range()
+{
+    vector<unsigned> hits(10007, 0);
+    parallel_for(0, hits.size(), 100, [&hits](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            hits.at(i)++;
+        }
+    });
+    bool all_once = true;
+    for (unsigned hit : hits) {
+        all_once = all_once && hit == 1;
+    }
+    CHECK(all_once);
+    parallel_for(5, 5, 100, [](size_t lo, size_t hi) { FAILx(); });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void test_scheduler(int argc, const char **argv)
+{
+    ADD_TEST(task_group_empty);
+    ADD_TEST(task_group_runs_all);
+    ADD_TEST(task_group_nested);
+    ADD_TEST(task_group_exception);
+    ADD_TEST(task_group_fairness);
+    ADD_TEST(parallel_for_covers_range);
+    RUN_TESTS();
+}
@@ -0,0 +1,620 @@
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+#include "Compression.h"
+#include "Database.h"
+#include "unittest.h"
+#include "util.h"
+
+using namespace std;
+
+static string db_dir;
+
+// ------------------------------------------------------------------------------------------
+
+// Setup
+
+static void cleanup()
+{
+    Database::delete_all();
+}
+
+static Table* load(const string& name, const string& filename, const ColumnNames& columns)
+{
+    Table* table = Database::new_table(name, columns);
+    load_csv(table, db_dir + filename);
+    return table;
+}
+
+static bool same_rows(Table* x, Table* y)
+{
+    Iterator* x_scan = table_scan(x);
+    Iterator* y_scan = table_scan(y);
+    bool same = match(x_scan, y_scan);
+    delete x_scan;
+    delete y_scan;
+    return same;
+}
+
+static bool throws_table_exception(void (*f)())
+{
+    try {
+        f();
+    } catch (TableException& e) {
+        return true;
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Snapshots
+
+void snapshot_round_trip()
+{
+    const char* path = "snapshot_round_trip.snap";
+    load("user", "user.csv", ColumnNames{"user_id", "username", "birth_date"});
+    load("routing", "routing.csv", ColumnNames{"from_user_id", "to_user_id", "message_id"});
+    load("message", "message.csv", ColumnNames{"message_id", "send_date", "text"});
+    save_snapshot(Database::tables(), path);
+    Database::delete_all();
+    vector<Table*> tables = load_snapshot(path);
+    CHECK(tables.size() == 3);
+    CHECK(tables.at(0) == Database::table("message"));
+    CHECK(tables.at(1) == Database::table("routing"));
+    CHECK(tables.at(2) == Database::table("user"));
+    CHECK(Database::table("user")->columns() == ColumnNames({"user_id", "username", "birth_date"}));
+    CHECK(same_rows(Database::table("user"),
+                    load("user_csv", "user.csv", ColumnNames{"user_id", "username", "birth_date"})));
+    CHECK(same_rows(Database::table("routing"),
+                    load("routing_csv", "routing.csv", ColumnNames{"from_user_id", "to_user_id", "message_id"})));
+    CHECK(same_rows(Database::table("message"),
+                    load("message_csv", "message.csv", ColumnNames{"message_id", "send_date", "text"})));
+    remove(path);
+}
+
+void snapshot_empty_values()
+{
+    const char* path = "snapshot_empty_values.snap";
+    Table* empty = Database::new_table("empty", ColumnNames{"a"});
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    add(t, {"", "x"});
+    add(t, {"y", ""});
+    save_snapshot({empty, t}, path);
+    Database::delete_all();
+    vector<Table*> tables = load_snapshot(path);
+    CHECK(tables.size() == 2);
+    CHECK(tables.at(0)->rows().empty());
+    Table* control = Database::new_table("control", ColumnNames{"a", "b"});
+    add(control, {"", "x"});
+    add(control, {"y", ""});
+    CHECK(same_rows(control, tables.at(1)));
+    remove(path);
+}
+
+static void load_truncated_snapshot()
+{
+    load_snapshot("snapshot_truncated.snap");
+}
+
+static void load_csv_as_snapshot()
+{
+    load_snapshot(db_dir + "user.csv");
+}
+
+void snapshot_rejects_bad_files()
+{
+    const char* path = "snapshot_truncated.snap";
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    add(t, {"1", "2"});
+    add(t, {"3", "4"});
+    save_snapshot({t}, path);
+    Database::delete_all();
+    // Chop off the last value
+    FILE* file = fopen(path, "r+");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    CHECK(truncate(path, size - 1) == 0);
+    CHECK(throws_table_exception(load_truncated_snapshot));
+    CHECK(throws_table_exception(load_csv_as_snapshot));
+    CHECK(Database::tables().empty());
+    remove(path);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Persisted indexes
+
+static bool same_index(Index* x, Index* y)
+{
+    return x->key_columns() == y->key_columns() &&
+           x->size() == y->size() &&
+           equal(x->begin(), x->end(), y->begin());
+}
+
+void index_round_trip()
+{
+    const char* path = "index_round_trip.idx";
+    Table* user = load("user", "user.csv", ColumnNames{"user_id", "username", "birth_date"});
+    Index* built = user->add_index(ColumnNames{"username", "user_id"});
+    built->save(path);
+    Index* opened = user->open_index(path);
+    CHECK(opened != NULL);
+    CHECK(same_index(built, opened));
+    // A new process loading the same data gets the same table version, so the index is still good.
+    Database::delete_all();
+    user = load("user", "user.csv", ColumnNames{"user_id", "username", "birth_date"});
+    opened = user->open_index(path);
+    CHECK(opened != NULL);
+    CHECK(same_index(user->add_index(ColumnNames{"username", "user_id"}), opened));
+    remove(path);
+}
+
+static void load_pairs_into(Table* t, const vector<vector<string>>& pairs)
+{
+    RowList rows;
+    for (const vector<string>& pair : pairs) {
+        rows.emplace_back(new TestRow(t, pair));
+    }
+    t->add_all(rows);
+}
+
+static Table* load_pairs(const vector<vector<string>>& pairs)
+{
+    Table* t = Database::new_table("t", ColumnNames{"k", "v"});
+    load_pairs_into(t, pairs);
+    return t;
+}
+
+void index_stale()
+{
+    const char* path = "index_stale.idx";
+    Table* t = load_pairs({{"b", "1"}, {"a", "2"}, {"c", "3"}});
+    t->add_index(ColumnNames{"k"})->save(path);
+    // A different version
+    add(t, {"d", "4"});
+    CHECK(t->open_index(path) == NULL);
+    // The same version and number of rows, but different keys
+    Database::delete_all();
+    t = load_pairs({{"b", "1"}, {"x", "2"}, {"c", "3"}});
+    CHECK(t->open_index(path) == NULL);
+    // A different table
+    Database::delete_all();
+    Table* u = Database::new_table("u", ColumnNames{"k", "v"});
+    CHECK(u->open_index(path) == NULL);
+    // The same data again
+    Database::delete_all();
+    t = load_pairs({{"b", "1"}, {"a", "2"}, {"c", "3"}});
+    CHECK(t->open_index(path) != NULL);
+    // Rows added after the index was built, but before it was saved
+    Database::delete_all();
+    t = load_pairs({{"b", "1"}, {"a", "2"}, {"c", "3"}});
+    Index* built = t->add_index(ColumnNames{"k"});
+    add(t, {"d", "4"});
+    built->save(path);
+    CHECK(t->open_index(path) == NULL);
+    remove(path);
+}
+
+static void open_csv_as_index()
+{
+    Table* t = Database::new_table("t", ColumnNames{"k"});
+    t->open_index(db_dir + "user.csv");
+}
+
+void index_rejects_bad_files()
+{
+    CHECK(throws_table_exception(open_csv_as_index));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Compression
+
+static const CompressedColumn::Codec CODECS[] = {
+    CompressedColumn::PLAIN,
+    CompressedColumn::RUN_LENGTH,
+    CompressedColumn::DELTA,
+    CompressedColumn::DICTIONARY
+};
+
+// Check the column against the values at the given position of the rows, decoding and filtering both from the
+// start, and from the middle of the column.
+static bool column_matches(const CompressedColumn* column, const RowList& rows, unsigned position)
+{
+    static const vector<pair<string, string>> bounds = {
+        {"", "~"}, {"1000010", "1000100"}, {"1000010", "1000010"}, {"1012", "1012"}, {"2016/", "2016/12/31"},
+        {"2017/01/01", "2015/01/01"}, {"5", "x"}, {"100001", "1000050"}, {"0000000", "9999999"}
+    };
+    if (column->size() != rows.size()) {
+        return false;
+    }
+    for (size_t begin : {(size_t) 0, rows.size() / 3}) {
+        vector<string> values;
+        column->decode(begin, rows.size(), values);
+        for (size_t i = begin; i < rows.size(); i++) {
+            if (values.at(i - begin) != rows.at(i)->at(position)) {
+                return false;
+            }
+        }
+        for (const pair<string, string>& bound : bounds) {
+            vector<char> selected(rows.size() - begin, 1);
+            column->filter(begin, rows.size(), bound.first, bound.second, selected);
+            for (size_t i = begin; i < rows.size(); i++) {
+                const string& value = rows.at(i)->at(position);
+                if ((bool) selected.at(i - begin) != (bound.first <= value && value <= bound.second)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void compression_codecs()
+{
+    load("routing", "routing.csv", ColumnNames{"from_user_id", "to_user_id", "message_id"});
+    load("message", "message.csv", ColumnNames{"message_id", "send_date", "text"});
+    for (Table* table : Database::tables()) {
+        for (unsigned c = 0; c < table->columns().size(); c++) {
+            for (CompressedColumn::Codec codec : CODECS) {
+                CompressedColumn* column = CompressedColumn::compress(table->rows(), c, codec);
+                // All routing columns are integers of one width. Of the message columns, only message_id is.
+                bool integers = table->name() == "routing" || c == 0;
+                if (codec == CompressedColumn::DELTA && !integers) {
+                    CHECK(column == NULL);
+                    continue;
+                }
+                CHECK(column != NULL);
+                CHECK(column->codec() == codec);
+                CHECK(column_matches(column, table->rows(), c));
+                delete column;
+            }
+        }
+    }
+}
+
+void compression_scan()
+{
+    Table* routing = load("routing", "routing.csv", ColumnNames{"from_user_id", "to_user_id", "message_id"});
+    Table* message = load("message", "message.csv", ColumnNames{"message_id", "send_date", "text"});
+    CompressedTable compressed_routing(routing);
+    CompressedTable compressed_message(message);
+    CHECK(compressed_message.column(0)->codec() == CompressedColumn::DELTA);
+    CHECK(compressed_routing.column(2)->codec() == CompressedColumn::DELTA);
+    size_t plain = 0;
+    for (unsigned c = 0; c < routing->columns().size(); c++) {
+        CompressedColumn* column = CompressedColumn::compress(routing->rows(), c, CompressedColumn::PLAIN);
+        plain += column->memory_bytes();
+        delete column;
+    }
+    CHECK(compressed_routing.memory_bytes() * 4 < plain);
+    // No ranges
+    Iterator* scan = compressed_scan(&compressed_message);
+    Iterator* expected = table_scan(message);
+    CHECK(match(scan, expected));
+    delete scan;
+    delete expected;
+    // message_id in [1000100, 1000199], and sent in 2016
+    scan = compressed_scan(&compressed_message,
+                           {{0, "1000100", "1000199"}, {1, "2016/01/01", "2016/12/31"}});
+    Table* filtered = Database::new_table("filtered", message->columns());
+    for (Row* row : message->rows()) {
+        if (row->at(0) >= "1000100" && row->at(0) <= "1000199" && row->at(1).compare(0, 5, "2016/") == 0) {
+            add(filtered, *row);
+        }
+    }
+    CHECK(!filtered->rows().empty());
+    expected = table_scan(filtered);
+    CHECK(match(scan, expected));
+    delete scan;
+    delete expected;
+    // Nothing qualifies
+    scan = compressed_scan(&compressed_routing, {{0, "1012", "1012"}, {1, "x", "y"}});
+    expected = table_scan(Database::new_table("none", routing->columns()));
+    CHECK(match(scan, expected));
+    delete scan;
+    delete expected;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Paged tables
+
+void buffer_pool_eviction()
+{
+    const char* path = "buffer_pool_eviction.pages";
+    BufferPool pool(path, 2);
+    // Write a distinct byte to each of 5 pages, through 2 frames.
+    for (char c = 'a'; c < 'f'; c++) {
+        PageId page = pool.allocate();
+        CHECK(page == (PageId) (c - 'a'));
+        pool.pin(page)[0] = c;
+        pool.unpin(page, true);
+        pool.unpin(page, true);
+    }
+    CHECK(pool.n_writes() == 3);
+    for (char c = 'a'; c < 'f'; c++) {
+        PageId page = (PageId) (c - 'a');
+        CHECK(pool.pin(page)[0] == c);
+        pool.unpin(page, false);
+    }
+    CHECK(pool.n_reads() >= 3);
+    // Pinned pages stay put, and with every frame pinned, no other page can be pinned.
+    char* a = pool.pin(0);
+    char* b = pool.pin(1);
+    bool threw = false;
+    try {
+        pool.pin(2);
+    } catch (TableException& e) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(a[0] == 'a' && b[0] == 'b');
+    pool.unpin(0, false);
+    pool.unpin(1, false);
+    CHECK(pool.pin(2)[0] == 'c');
+    pool.unpin(2, false);
+}
+
+void paged_table_scan()
+{
+    const char* path = "paged_table_scan.pages";
+    BufferPool pool(path, 1);
+    ColumnNames columns{"message_id", "send_date", "text"};
+    Table* message = load("message", "message.csv", columns);
+    Table* paged = Database::new_table("paged", columns, &pool);
+    load_csv(paged, db_dir + "message.csv");
+    CHECK(paged->paged());
+    CHECK(paged->rows().empty());
+    CHECK(paged->n_rows() == message->n_rows());
+    // The table spans more pages than fit in the pool, so scanning it reads pages back.
+    unsigned long reads = pool.n_reads();
+    CHECK(same_rows(message, paged));
+    CHECK(pool.n_reads() > reads);
+    // Index scans, and zone maps
+    Index* index = paged->add_index(ColumnNames{"send_date"});
+    Index* expected_index = message->add_index(ColumnNames{"send_date"});
+    TestRow lo(NULL, {"2016/01/01"});
+    TestRow hi(NULL, {"2016/12/31"});
+    Iterator* scan = index_scan(index, &lo, &hi);
+    Iterator* expected = index_scan(expected_index, &lo, &hi);
+    CHECK(match(scan, expected));
+    delete scan;
+    delete expected;
+    vector<ColumnRange> ranges{{0, "1000100", "1000199"}};
+    scan = zone_scan(paged, ranges);
+    expected = zone_scan(message, ranges);
+    CHECK(match(scan, expected));
+    delete scan;
+    delete expected;
+    // Rows too large for a page are rejected.
+    Table* t = Database::new_table("t", ColumnNames{"k"}, &pool);
+    add(t, {""});
+    TestRow big(t, {string(BufferPool::PAGE_SIZE, 'x')});
+    bool threw = false;
+    try {
+        t->add(&big);
+    } catch (TableException& e) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(t->n_rows() == 1);
+    // The tables must go before the pool.
+    Database::delete_all();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Write-ahead log
+
+static const char* WAL_SNAPSHOT = "wal_test.snap";
+static const char* WAL_LOG = "wal_test.log";
+
+static void remove_wal_files()
+{
+    remove(WAL_SNAPSHOT);
+    remove(WAL_LOG);
+}
+
+// Simulate a crash and restart: forget the tables, and recover them.
+static void restart()
+{
+    Database::delete_all();
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+}
+
+static bool has_rows(Table* table, const vector<vector<string>>& expected)
+{
+    if (table == NULL || table->n_rows() != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        Row* row = table->row(i);
+        bool eq = row_eq(row, expected.at(i));
+        Row::reclaim(row);
+        if (!eq) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static long file_size(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static void copy_file(const char* from, const char* to)
+{
+    FILE* in = fopen(from, "rb");
+    FILE* out = fopen(to, "wb");
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        fwrite(buffer, 1, n, out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+void wal_recovery()
+{
+    remove_wal_files();
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    Table* t = Database::new_table("t", ColumnNames{"a", "b"});
+    add(t, {"1", "x"});
+    add(t, {"2", ""});
+    load_pairs_into(Database::new_table("u", ColumnNames{"k", "v"}), {{"p", "q"}, {"r", "s"}});
+    restart();
+    CHECK(has_rows(Database::table("t"), {{"1", "x"}, {"2", ""}}));
+    CHECK(has_rows(Database::table("u"), {{"p", "q"}, {"r", "s"}}));
+    // Recovery from a snapshot and then the log
+    Database::checkpoint();
+    add(Database::table("t"), {"3", "y"});
+    Database::sync();
+    restart();
+    CHECK(has_rows(Database::table("t"), {{"1", "x"}, {"2", ""}, {"3", "y"}}));
+    CHECK(has_rows(Database::table("u"), {{"p", "q"}, {"r", "s"}}));
+    Database::delete_all();
+    remove_wal_files();
+}
+
+void wal_torn_tail()
+{
+    remove_wal_files();
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    Table* t = Database::new_table("t", ColumnNames{"a"});
+    add(t, {"1"});
+    add(t, {"2"});
+    Database::close();
+    // A crash in the middle of writing the last record
+    CHECK(truncate(WAL_LOG, file_size(WAL_LOG) - 1) == 0);
+    restart();
+    CHECK(has_rows(Database::table("t"), {{"1"}}));
+    // New records follow the intact ones.
+    add(Database::table("t"), {"3"});
+    restart();
+    CHECK(has_rows(Database::table("t"), {{"1"}, {"3"}}));
+    Database::delete_all();
+    remove_wal_files();
+}
+
+void wal_crash_during_checkpoint()
+{
+    const char* old_log = "wal_test.log.old";
+    remove_wal_files();
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    add(Database::new_table("t", ColumnNames{"a"}), {"1"});
+    Database::sync();
+    copy_file(WAL_LOG, old_log);
+    Database::checkpoint();
+    // A crash after the checkpoint's snapshot, but before the log was replaced
+    Database::delete_all();
+    CHECK(rename(old_log, WAL_LOG) == 0);
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    CHECK(has_rows(Database::table("t"), {{"1"}}));
+    Database::delete_all();
+    remove_wal_files();
+}
+
+void wal_paged_recovery()
+{
+    const char* path = "wal_paged_recovery.pages";
+    remove_wal_files();
+    BufferPool pool(path, 4);
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    add(Database::new_table("t", ColumnNames{"a"}, &pool), {"1"});
+    add(Database::new_table("u", ColumnNames{"a"}), {"2"});
+    Database::delete_all();
+    Database::open(WAL_SNAPSHOT, WAL_LOG, &pool);
+    CHECK(Database::table("t")->paged());
+    CHECK(!Database::table("u")->paged());
+    CHECK(has_rows(Database::table("t"), {{"1"}}));
+    CHECK(has_rows(Database::table("u"), {{"2"}}));
+    // Recovery from a snapshot
+    Database::checkpoint();
+    Database::delete_all();
+    Database::open(WAL_SNAPSHOT, WAL_LOG, &pool);
+    CHECK(Database::table("t")->paged());
+    CHECK(!Database::table("u")->paged());
+    CHECK(has_rows(Database::table("t"), {{"1"}}));
+    // Without a pool, paged tables are recovered in memory.
+    Database::delete_all();
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    CHECK(!Database::table("t")->paged());
+    CHECK(has_rows(Database::table("t"), {{"1"}}));
+    // The tables must go before the pool.
+    Database::delete_all();
+    remove_wal_files();
+}
+
+void wal_failed_add()
+{
+    const char* path = "wal_failed_add.pages";
+    remove_wal_files();
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    {
+        BufferPool pool(path, 1);
+        Table* t = Database::new_table("t", ColumnNames{"a"}, &pool);
+        add(t, {"1"});
+        Table* u = Database::new_table("u", ColumnNames{"a"}, &pool);
+        // With t's page pinned, there is no frame for u's first page, so the row can't be stored, and mustn't be
+        // logged.
+        pool.pin(0);
+        TestRow row(u, {"2"});
+        bool threw = false;
+        try {
+            u->add(&row);
+        } catch (TableException& e) {
+            threw = true;
+        }
+        CHECK(threw);
+        CHECK(u->n_rows() == 0);
+        pool.unpin(0, false);
+        Database::sync();
+        // The tables must go before the pool.
+        Database::delete_all();
+    }
+    Database::open(WAL_SNAPSHOT, WAL_LOG);
+    CHECK(Database::table("t")->n_rows() == 1);
+    CHECK(Database::table("u")->n_rows() == 0);
+    Database::delete_all();
+    remove_wal_files();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void test_storage(int argc, const char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Specify the directory containing the .csv files as a command-line argument.\n");
+        exit(1);
+    }
+    db_dir = argv[1];
+    if (db_dir.at(db_dir.size() - 1) != '/') {
+        db_dir += '/';
+    }
+    AFTER_TEST(cleanup);
+    ADD_TEST(snapshot_round_trip);
+    ADD_TEST(snapshot_empty_values);
+    ADD_TEST(snapshot_rejects_bad_files);
+    ADD_TEST(index_round_trip);
+    ADD_TEST(index_stale);
+    ADD_TEST(index_rejects_bad_files);
+    ADD_TEST(compression_codecs);
+    ADD_TEST(compression_scan);
+    ADD_TEST(buffer_pool_eviction);
+    ADD_TEST(paged_table_scan);
+    ADD_TEST(wal_recovery);
+    ADD_TEST(wal_torn_tail);
+    ADD_TEST(wal_crash_during_checkpoint);
+    ADD_TEST(wal_paged_recovery);
+    ADD_TEST(wal_failed_add);
+    RUN_TESTS();
+}
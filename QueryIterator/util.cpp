@@ -1,8 +1,11 @@
 #include <cassert>
+#include <cstdio>
+#include <unistd.h>
 #include "util.h"
 #include "dbexceptions.h"
 #include "Table.h"
 #include "Iterator.h"
+#include "ResultWriter.h"
 
 TestRow::TestRow(Table* table, const vector<string>& values)
     : Row(table)
@@ -90,20 +93,7 @@ bool match(Iterator* x, Iterator* y)
 void print_iterator(const char* label, Iterator* input)
 {
     printf("%s:\n", label);
-    Row* row;
-    int n_columns = input->n_columns();
-    input->open();
-    while ((row = input->next())) {
-        for (int i = 0; i < n_columns; i++) {
-            if (i > 0) {
-                printf("\t");
-            }
-            printf("%s", row->at(i).c_str());
-        }
-        printf("\n");
-        done_with(row);
-    }
-    input->close();
+    // The rows go straight to the file descriptor, so anything printed before them must get there first.
+    fflush(stdout);
+    write_iterator(input, STDOUT_FILENO, TSV);
 }
-
-
@@ -1,4 +1,5 @@
 #include "ColumnNames.h"
+#include "dbexceptions.h"
 
 int ColumnNames::position(const string &name) const
 {
@@ -21,3 +22,17 @@ ColumnNames::ColumnNames(const ColumnNames &columns)
 ColumnNames::ColumnNames(initializer_list<string> elements)
         : vector<string>(elements)
 {}
+
+unsigned ColumnHandle::position() const
+{
+    return _position;
+}
+
+ColumnHandle::ColumnHandle(const ColumnNames &columns, const string &name)
+{
+    int position = columns.position(name);
+    if (position == -1) {
+        throw TableException("Unknown column " + name);
+    }
+    _position = (unsigned) position;
+}
@@ -1,19 +1,53 @@
+#include <algorithm>
 #include <sstream>
 #include "Database.h"
 
 unordered_map<string, Table*> Database::_tables;
 unsigned Database::_table_name_counter = 0;
+QueryScope *Database::_scope = NULL;
 
-Table* Database::new_table(const string &name, const ColumnNames &columns)
+Table* Database::new_table(const string &name, const ColumnNames &columns, RowSet::Kind kind)
 {
     if (_tables.find(name) != _tables.end()) {
         throw TableException("Table name already in use");
     }
-    auto table = new Table(name, columns);
+    auto table = new Table(name, columns, kind);
     _tables.insert({{name, table}});
+    if (_scope != NULL) {
+        _scope->add_table(table);
+    }
     return table;
 }
 
+Table* Database::table(const string &name)
+{
+    auto found = _tables.find(name);
+    return found == _tables.end() ? NULL : found->second;
+}
+
+void Database::drop_table(Table *table)
+{
+    if (table->_scope != NULL) {
+        table->_scope->remove_table(table);
+    }
+    _tables.erase(table->name());
+    delete table;
+}
+
+size_t Database::n_tables()
+{
+    return _tables.size();
+}
+
+size_t Database::bytes()
+{
+    size_t bytes = 0;
+    for (auto &entry : _tables) {
+        bytes += entry.second->bytes();
+    }
+    return bytes;
+}
+
 string Database::new_table_name()
 {
     string name;
@@ -28,9 +62,86 @@ string Database::new_table_name()
 
 void Database::delete_all_tables()
 {
+    for (QueryScope *scope = _scope; scope != NULL; scope = scope->_parent) {
+        scope->clear();
+    }
     auto i = _tables.begin();
     while (i != _tables.end()) {
         delete i++->second;
     }
     _tables.clear();
 }
+
+//----------------------------------------------------------------------
+
+// QueryScope
+
+Table *QueryScope::keep(Table *table)
+{
+    if (table->_scope == this) {
+        // Enclosing scopes already count the table's rows.
+        _tables.erase(find(_tables.begin(), _tables.end(), table));
+        _bytes -= table->bytes();
+        table->_scope = _parent;
+        if (_parent != NULL) {
+            _parent->_tables.push_back(table);
+        }
+    }
+    return table;
+}
+
+size_t QueryScope::bytes() const
+{
+    return _bytes;
+}
+
+size_t QueryScope::peak_bytes() const
+{
+    return _peak_bytes;
+}
+
+QueryScope::QueryScope()
+    : _parent(Database::_scope),
+      _bytes(0),
+      _peak_bytes(0)
+{
+    Database::_scope = this;
+}
+
+QueryScope::~QueryScope()
+{
+    while (!_tables.empty()) {
+        Database::drop_table(_tables.back());
+    }
+    Database::_scope = _parent;
+}
+
+void QueryScope::add_table(Table *table)
+{
+    _tables.push_back(table);
+    table->_scope = this;
+}
+
+// Remove a table that is being dropped from this scope, (and its rows' bytes from this and enclosing scopes).
+void QueryScope::remove_table(Table *table)
+{
+    _tables.erase(find(_tables.begin(), _tables.end(), table));
+    add_bytes(-(long) table->bytes());
+    table->_scope = NULL;
+}
+
+// Count bytes added to, (or removed from, if delta is negative), the rows of a table of this scope, or of a
+// nested scope.
+void QueryScope::add_bytes(long delta)
+{
+    for (QueryScope *scope = this; scope != NULL; scope = scope->_parent) {
+        scope->_bytes += delta;
+        scope->_peak_bytes = max(scope->_peak_bytes, scope->_bytes);
+    }
+}
+
+void QueryScope::clear()
+{
+    _tables.clear();
+    _bytes = 0;
+}
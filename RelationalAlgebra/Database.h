@@ -9,17 +9,80 @@
 class Database
 {
 public:
-    // Returns a new, empty table, with the given name, and column names.
-    static Table* new_table(const string &name, const ColumnNames &columns);
+    // Returns a new, empty table, with the given name, and column names, keeping its rows in a RowSet of the
+    // given kind.
+    static Table* new_table(const string &name, const ColumnNames &columns, RowSet::Kind kind = RowSet::TREE);
 
-    // Delete all tables and rows, resulting an an empty database.
+    // Delete all tables and rows, resulting an an empty database. Any QueryScopes are left empty.
     static void delete_all_tables();
 
+    // The table with the given name, or NULL if there is none
+    static Table* table(const string &name);
+
+    // Delete the table, (which must have been created by new_table, and not be used afterwards).
+    static void drop_table(Table *table);
+
+    // The number of tables, and an estimate of the memory held by their rows, in bytes
+    static size_t n_tables();
+    static size_t bytes();
+
     static string new_table_name();
 
 private:
+    friend class QueryScope;
+
     static unordered_map<string, Table*> _tables;
     static unsigned _table_name_counter;
+    static QueryScope *_scope;                      // The innermost scope, or NULL
+};
+
+// The lifetime of the tables of a query, (typically the intermediate results of relational algebra operators).
+// Tables created while a scope exists belong to the innermost scope, and are dropped when it ends, except for those
+// passed to keep, which pass to the enclosing scope, (or to the Database, if there is none). Scopes must be ended
+// in the reverse order of their creation, (as they are when declared as local variables).
+//
+// A scope also tracks the memory held by the rows of its tables, (including those of nested scopes), e.g.
+//
+//     Table *result;
+//     {
+//         QueryScope scope;
+//         result = scope.keep(project(select(join(r, s), predicate), columns));
+//         printf("peak: %lu bytes\n", scope.peak_bytes());
+//     }
+//     // The join and select results are gone.
+class QueryScope
+{
+public:
+    // Keep table after this scope ends, returning it.
+    Table *keep(Table *table);
+
+    // An estimate of the memory held by the rows of this scope's tables, now, and at most, since the scope
+    // was created, in bytes
+    size_t bytes() const;
+    size_t peak_bytes() const;
+
+    QueryScope();
+
+    // Drop the tables of this scope that weren't kept.
+    ~QueryScope();
+
+    QueryScope(const QueryScope &) = delete;
+    QueryScope &operator=(const QueryScope &) = delete;
+
+private:
+    friend class Database;
+    friend class Table;
+
+    void add_table(Table *table);
+    void remove_table(Table *table);
+    void add_bytes(long delta);
+    void clear();
+
+private:
+    QueryScope *_parent;
+    vector<Table*> _tables;
+    size_t _bytes;
+    size_t _peak_bytes;
 };
 
 
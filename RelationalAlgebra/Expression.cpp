@@ -0,0 +1,453 @@
+#include <cstdint>
+#include "Expression.h"
+#include "Database.h"
+#include "Plan.h"
+
+// Defined in RelationalAlgebra.cpp
+ColumnNames renamedColumns(const ColumnNames &columns, const NameMap &name_map);
+
+//----------------------------------------------------------------------
+
+// Expression
+
+const ColumnNames &Expression::columns() const
+{
+	return _schema->columns();
+}
+
+const string &Expression::name() const
+{
+	return _name;
+}
+
+const Table *Expression::schema() const
+{
+	return _schema;
+}
+
+Expression::Expression(const string &name, const Table *schema)
+	: _name(name),
+	  _schema(schema),
+	  _owned_schema(NULL)
+{}
+
+Expression::Expression(const string &name, const ColumnNames &columns)
+	: _name(name),
+	  _schema(NULL),
+	  _owned_schema(new Table(name, columns))
+{
+	_schema = _owned_schema;
+}
+
+Expression::~Expression()
+{
+	delete _owned_schema;
+}
+
+// Append a name to a canonical form, prefixed by its length, so that the name can contain any characters.
+static void canonicalName(string &key, const string &name)
+{
+	key += to_string(name.size());
+	key += ':';
+	key += name;
+}
+
+static void canonicalColumns(string &key, const ColumnNames &columns)
+{
+	key += '[';
+	for (const string &column : columns)
+		canonicalName(key, column);
+	key += ']';
+}
+
+//----------------------------------------------------------------------
+
+// Operators
+
+class Scan : public Expression
+{
+public:
+	Iterator *plan() override
+	{
+		return scan_plan(_table);
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		key += "scan(";
+		canonicalName(key, _table->name());
+		key += '#';
+		key += to_string(_table->id());
+		key += ')';
+		tables.push_back(_table);
+	}
+
+	Scan(Table *table)
+		: Expression(table->name(), table),
+		  _table(table)
+	{}
+
+private:
+	Table *_table;
+};
+
+// Base class of operators with one input
+class UnaryExpression : public Expression
+{
+public:
+	~UnaryExpression()
+	{
+		delete _input;
+	}
+
+protected:
+	UnaryExpression(Expression *input, const Table *schema)
+		: Expression(Database::new_table_name(), schema),
+		  _input(input)
+	{}
+
+	UnaryExpression(Expression *input, const ColumnNames &columns)
+		: Expression(Database::new_table_name(), columns),
+		  _input(input)
+	{}
+
+	Expression *_input;
+};
+
+// Base class of operators with two inputs
+class BinaryExpression : public Expression
+{
+public:
+	~BinaryExpression()
+	{
+		delete _left;
+		delete _right;
+	}
+
+protected:
+	BinaryExpression(Expression *left, Expression *right, const Table *schema)
+		: Expression(Database::new_table_name(), schema),
+		  _left(left),
+		  _right(right)
+	{}
+
+	BinaryExpression(Expression *left, Expression *right, const ColumnNames &columns)
+		: Expression(Database::new_table_name(), columns),
+		  _left(left),
+		  _right(right)
+	{}
+
+	Expression *_left;
+	Expression *_right;
+};
+
+class SelectExpression : public UnaryExpression
+{
+public:
+	Iterator *plan() override
+	{
+		return select_plan(_input->plan(), _predicate);
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		key += "select(";
+		key += to_string((uintptr_t) _predicate);
+		key += ',';
+		_input->canonical(key, tables);
+		key += ')';
+	}
+
+	SelectExpression(Expression *input, RowPredicate predicate)
+		: UnaryExpression(input, input->schema()),
+		  _predicate(predicate)
+	{}
+
+private:
+	RowPredicate _predicate;
+};
+
+class ProjectExpression : public UnaryExpression
+{
+public:
+	Iterator *plan() override
+	{
+		return distinct_plan(project_plan(_input->plan(), schema(), _positions));
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		key += "project(";
+		canonicalColumns(key, columns());
+		_input->canonical(key, tables);
+		key += ')';
+	}
+
+	ProjectExpression(Expression *input, const ColumnNames &columns)
+		: UnaryExpression(input, columns)
+	{
+		for (unsigned int i = 0; i < columns.size(); i++)
+			_positions.push_back((unsigned) input->columns().position(columns[i]));
+	}
+
+private:
+	vector<unsigned> _positions;
+};
+
+class RenameExpression : public UnaryExpression
+{
+public:
+	Iterator *plan() override
+	{
+		return rename_plan(_input->plan(), schema());
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		key += "rename(";
+		canonicalColumns(key, columns());
+		_input->canonical(key, tables);
+		key += ')';
+	}
+
+	RenameExpression(Expression *input, const ColumnNames &columns)
+		: UnaryExpression(input, columns)
+	{}
+};
+
+class UnionExpression : public BinaryExpression
+{
+public:
+	Iterator *plan() override
+	{
+		return distinct_plan(union_plan(_left->plan(), _right->plan()));
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		key += "union(";
+		_left->canonical(key, tables);
+		key += ',';
+		_right->canonical(key, tables);
+		key += ')';
+	}
+
+	UnionExpression(Expression *left, Expression *right)
+		: BinaryExpression(left, right, left->schema())
+	{}
+};
+
+// Intersection if keep_matches is true, difference otherwise
+class IntersectOrDiffExpression : public BinaryExpression
+{
+public:
+	Iterator *plan() override
+	{
+		return intersect_or_diff_plan(_left->plan(), _right->plan(), _keep_matches);
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		key += _keep_matches ? "intersect(" : "diff(";
+		_left->canonical(key, tables);
+		key += ',';
+		_right->canonical(key, tables);
+		key += ')';
+	}
+
+	IntersectOrDiffExpression(Expression *left, Expression *right, bool keep_matches)
+		: BinaryExpression(left, right, left->schema()),
+		  _keep_matches(keep_matches)
+	{}
+
+private:
+	bool _keep_matches;
+};
+
+class ProductExpression : public BinaryExpression
+{
+public:
+	Iterator *plan() override
+	{
+		return product_plan(_left->plan(), _right->plan(), schema());
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		// The columns are prefixed by the names of the inputs, which are new for inputs other than tables.
+		key += "product(";
+		canonicalColumns(key, columns());
+		_left->canonical(key, tables);
+		key += ',';
+		_right->canonical(key, tables);
+		key += ')';
+	}
+
+	ProductExpression(Expression *left, Expression *right, const ColumnNames &columns)
+		: BinaryExpression(left, right, columns)
+	{}
+};
+
+class JoinExpression : public BinaryExpression
+{
+public:
+	Iterator *plan() override
+	{
+		return join_plan(_left->plan(), _right->plan(), schema(),
+						 _left_positions, _right_positions, _right_other_positions);
+	}
+
+	void canonical(string &key, vector<const Table *> &tables) const override
+	{
+		key += "join(";
+		_left->canonical(key, tables);
+		key += ',';
+		_right->canonical(key, tables);
+		key += ')';
+	}
+
+	JoinExpression(Expression *left, Expression *right, const ColumnNames &columns,
+				   const vector<unsigned> &left_positions, const vector<unsigned> &right_positions,
+				   const vector<unsigned> &right_other_positions)
+		: BinaryExpression(left, right, columns),
+		  _left_positions(left_positions),
+		  _right_positions(right_positions),
+		  _right_other_positions(right_other_positions)
+	{}
+
+private:
+	vector<unsigned> _left_positions;
+	vector<unsigned> _right_positions;
+	vector<unsigned> _right_other_positions;
+};
+
+//----------------------------------------------------------------------
+
+// Factories
+
+// Check the arguments and create an operator, deleting its inputs, r and s, if either fails
+template <typename Create>
+static Expression *create(Create create, Expression *r, Expression *s = NULL)
+{
+	try {
+		return create();
+	}
+	catch (...) {
+		delete r;
+		delete s;
+		throw;
+	}
+}
+
+static void checkUnionCompatible(Expression *r, Expression *s, const char *message)
+{
+	if (r->columns().size() != s->columns().size())
+		throw UnionIncompatibilityException(message);
+}
+
+Expression *lazy(Table *r)
+{
+	return new Scan(r);
+}
+
+Table *evaluate(Expression *e)
+{
+	Iterator *plan = compile(e);
+	Table *result;
+	try {
+		result = materialize(plan);
+	}
+	catch (...) {
+		delete plan;
+		throw;
+	}
+	delete plan;
+	return result;
+}
+
+Expression *onion(Expression *r, Expression *s)
+{
+	return create([&]() -> Expression * {
+		checkUnionCompatible(r, s, "Tables have different columns.");
+		return new UnionExpression(r, s);
+	}, r, s);
+}
+
+Expression *intersect(Expression *r, Expression *s)
+{
+	return create([&]() -> Expression * {
+		checkUnionCompatible(r, s, "Two tables are not union compatible");
+		return new IntersectOrDiffExpression(r, s, true);
+	}, r, s);
+}
+
+Expression *diff(Expression *r, Expression *s)
+{
+	return create([&]() -> Expression * {
+		checkUnionCompatible(r, s, "Two tables are not union compatible");
+		return new IntersectOrDiffExpression(r, s, false);
+	}, r, s);
+}
+
+Expression *product(Expression *r, Expression *s)
+{
+	return create([&]() -> Expression * {
+		ColumnNames columns;
+		for (const string &column : r->columns()) {
+			if (s->columns().position(column) != -1)
+				throw TableException("input tables do not have disjoint column names");
+			columns.push_back(r->name() + column);
+		}
+		for (const string &column : s->columns())
+			columns.push_back(s->name() + column);
+		return new ProductExpression(r, s, columns);
+	}, r, s);
+}
+
+Expression *rename(Expression *r, const NameMap &name_map)
+{
+	return create([&]() -> Expression * {
+		return new RenameExpression(r, renamedColumns(r->columns(), name_map));
+	}, r);
+}
+
+Expression *select(Expression *r, RowPredicate predicate)
+{
+	return new SelectExpression(r, predicate);
+}
+
+Expression *project(Expression *r, const ColumnNames &columns)
+{
+	return create([&]() -> Expression * {
+		if (columns.empty())
+			throw TableException("Columns is empty");
+		for (const string &column : columns)
+			if (r->columns().position(column) == -1)
+				throw TableException("Can not refer to a column that does not exist");
+		return new ProjectExpression(r, columns);
+	}, r);
+}
+
+Expression *join(Expression *r, Expression *s)
+{
+	return create([&]() -> Expression * {
+		vector<unsigned> r_positions;
+		vector<unsigned> s_positions;
+		vector<unsigned> s_other_positions;
+		ColumnNames columns = r->columns();
+		for (unsigned j = 0; j < s->columns().size(); j++) {
+			int i = r->columns().position(s->columns()[j]);
+			if (i != -1) {
+				r_positions.push_back((unsigned) i);
+				s_positions.push_back(j);
+			}
+			else {
+				s_other_positions.push_back(j);
+				columns.push_back(s->columns()[j]);
+			}
+		}
+		if (r_positions.empty())
+			throw JoinException("Have no columns in common");
+		return new JoinExpression(r, s, columns, r_positions, s_positions, s_other_positions);
+	}, r, s);
+}
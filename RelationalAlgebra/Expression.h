@@ -0,0 +1,76 @@
+#ifndef RA_EXPRESSION_H
+#define RA_EXPRESSION_H
+
+#include "RelationalAlgebra.h"
+
+class Iterator;
+
+// A relational algebra expression, evaluated lazily. The functions below mirror those of RelationalAlgebra.h,
+// but instead of materializing a table for each operator, they build an expression tree. evaluate() then compiles
+// the tree into a pipelined plan, (see Plan.h), and runs it: each row streams from the input tables through all the
+// operators, and only the rows of the final result are materialized.
+//
+// Each function takes ownership of its expression arguments, and checks its arguments as the corresponding
+// function of RelationalAlgebra.h does, throwing the same exceptions.
+class Expression
+{
+public:
+    // The columns of the expression's result
+    const ColumnNames &columns() const;
+
+    // The name used as the column name prefix by product, (the table's name for lazy(table), a new table name
+    // otherwise, as for the tables created by the functions of RelationalAlgebra.h).
+    const string &name() const;
+
+    // The table that the rows produced by this expression belong to, (an input table, or a table that is not in
+    // the Database).
+    const Table *schema() const;
+
+    // A pipelined plan for this expression, (see Plan.h). The plan refers to the expression's schemas and
+    // predicates, so the expression must outlive it.
+    virtual Iterator *plan() = 0;
+
+    // Append a canonical form of this expression to key, and the tables it reads to tables. Expressions with the
+    // same canonical form have the same result, as long as the tables are unchanged. Predicates are identified by
+    // their address, so the result also depends on anything else that a predicate reads, (see ResultCache).
+    virtual void canonical(string &key, vector<const Table *> &tables) const = 0;
+
+    virtual ~Expression();
+
+protected:
+    // An expression producing rows that belong to schema, which must outlive the expression
+    Expression(const string &name, const Table *schema);
+
+    // An expression producing rows that belong to a new table with the given columns
+    Expression(const string &name, const ColumnNames &columns);
+
+private:
+    string _name;
+    const Table *_schema;
+    Table *_owned_schema;
+};
+
+// An expression for the rows of table r
+Expression *lazy(Table *r);
+
+// Evaluate the expression, (as materialize(compile(e))), and delete it, returning a new table in the Database,
+// containing the result.
+Table *evaluate(Expression *e);
+
+Expression *onion(Expression *r, Expression *s);
+
+Expression *intersect(Expression *r, Expression *s);
+
+Expression *diff(Expression *r, Expression *s);
+
+Expression *product(Expression *r, Expression *s);
+
+Expression *rename(Expression *r, const NameMap &name_map);
+
+Expression *select(Expression *r, RowPredicate predicate);
+
+Expression *project(Expression *r, const ColumnNames &columns);
+
+Expression *join(Expression *r, Expression *s);
+
+#endif //RA_EXPRESSION_H
@@ -0,0 +1,635 @@
+#include <unordered_map>
+#include <unordered_set>
+#include "Plan.h"
+#include "Database.h"
+
+typedef unordered_set<vector<string>, ValuesHash> ValuesSet;
+
+//----------------------------------------------------------------------
+
+// Iterator
+
+unsigned Iterator::n_columns()
+{
+	return (unsigned) schema()->columns().size();
+}
+
+Iterator::~Iterator()
+{}
+
+//----------------------------------------------------------------------
+
+// Operators
+
+// Base class of operators that build their output rows. The last row returned is kept until the next one.
+class RowBuilder : public Iterator
+{
+public:
+	~RowBuilder()
+	{
+		delete _row;
+	}
+
+protected:
+	RowBuilder()
+		: _row(NULL)
+	{}
+
+	// Start a new output row of the given table
+	Row *new_row(const Table *schema)
+	{
+		delete _row;
+		_row = new Row(schema);
+		return _row;
+	}
+
+	// Start a new output row of the given table, sharing the values of source
+	Row *new_row(const Table *schema, const Row &source)
+	{
+		delete _row;
+		_row = new Row(schema, source);
+		return _row;
+	}
+
+	void discard_row()
+	{
+		delete _row;
+		_row = NULL;
+	}
+
+private:
+	Row *_row;
+};
+
+class ScanPlan : public Iterator
+{
+public:
+	const Table *schema() override
+	{
+		return _table;
+	}
+
+	void open() override
+	{
+		_input = _table->rows().begin();
+		_end = _table->rows().end();
+	}
+
+	Row *next() override
+	{
+		return _input == _end ? NULL : *_input++;
+	}
+
+	void close() override
+	{
+		_input = _end;
+	}
+
+	ScanPlan(Table *table)
+		: _table(table)
+	{}
+
+private:
+	Table *_table;
+	RowSet::const_iterator _input;
+	RowSet::const_iterator _end;
+};
+
+class SelectPlan : public Iterator
+{
+public:
+	const Table *schema() override
+	{
+		return _input->schema();
+	}
+
+	void open() override
+	{
+		_input->open();
+	}
+
+	Row *next() override
+	{
+		Row *row;
+		while ((row = _input->next()) != NULL && !_predicate(row))
+			;
+		return row;
+	}
+
+	void close() override
+	{
+		_input->close();
+	}
+
+	SelectPlan(Iterator *input, RowPredicate predicate)
+		: _input(input),
+		  _predicate(predicate)
+	{}
+
+	~SelectPlan()
+	{
+		delete _input;
+	}
+
+private:
+	Iterator *_input;
+	RowPredicate _predicate;
+};
+
+class ProjectPlan : public RowBuilder
+{
+public:
+	const Table *schema() override
+	{
+		return _schema;
+	}
+
+	void open() override
+	{
+		_input->open();
+	}
+
+	Row *next() override
+	{
+		Row *input_row = _input->next();
+		if (input_row == NULL)
+			return NULL;
+		Row *row = new_row(_schema);
+		for (unsigned int i = 0; i < _positions.size(); i++)
+			row->append(input_row->at(_positions[i]));
+		return row;
+	}
+
+	void close() override
+	{
+		_input->close();
+		discard_row();
+	}
+
+	ProjectPlan(Iterator *input, const Table *schema, const vector<unsigned> &positions)
+		: _input(input),
+		  _schema(schema),
+		  _positions(positions)
+	{}
+
+	~ProjectPlan()
+	{
+		delete _input;
+	}
+
+private:
+	Iterator *_input;
+	const Table *_schema;
+	vector<unsigned> _positions;
+};
+
+// Gives the rows of its input to another table, (for renaming, and for the right input of a union).
+class RenamePlan : public RowBuilder
+{
+public:
+	const Table *schema() override
+	{
+		return _schema;
+	}
+
+	void open() override
+	{
+		_input->open();
+	}
+
+	Row *next() override
+	{
+		Row *input_row = _input->next();
+		return input_row == NULL ? NULL : new_row(_schema, *input_row);
+	}
+
+	void close() override
+	{
+		_input->close();
+		discard_row();
+	}
+
+	RenamePlan(Iterator *input, const Table *schema)
+		: _input(input),
+		  _schema(schema)
+	{}
+
+	~RenamePlan()
+	{
+		delete _input;
+	}
+
+private:
+	Iterator *_input;
+	const Table *_schema;
+};
+
+class DistinctPlan : public Iterator
+{
+public:
+	const Table *schema() override
+	{
+		return _input->schema();
+	}
+
+	void open() override
+	{
+		_input->open();
+		_seen.clear();
+	}
+
+	Row *next() override
+	{
+		Row *row;
+		while ((row = _input->next()) != NULL && !_seen.insert(row->data()).second)
+			;
+		return row;
+	}
+
+	void close() override
+	{
+		_input->close();
+		_seen.clear();
+	}
+
+	DistinctPlan(Iterator *input)
+		: _input(input)
+	{}
+
+	~DistinctPlan()
+	{
+		delete _input;
+	}
+
+private:
+	Iterator *_input;
+	ValuesSet _seen;
+};
+
+class UnionPlan : public Iterator
+{
+public:
+	const Table *schema() override
+	{
+		return _left->schema();
+	}
+
+	void open() override
+	{
+		_left->open();
+		_left_done = false;
+	}
+
+	Row *next() override
+	{
+		if (!_left_done) {
+			Row *row = _left->next();
+			if (row != NULL)
+				return row;
+			_left->close();
+			_right->open();
+			_left_done = true;
+		}
+		return _right->next();
+	}
+
+	void close() override
+	{
+		if (_left_done)
+			_right->close();
+		else
+			_left->close();
+		_left_done = false;
+	}
+
+	UnionPlan(Iterator *left, Iterator *right)
+		: _left(left),
+		  _right(rename_plan(right, left->schema())),
+		  _left_done(false)
+	{}
+
+	~UnionPlan()
+	{
+		delete _left;
+		delete _right;
+	}
+
+private:
+	Iterator *_left;
+	Iterator *_right;
+	bool _left_done;
+};
+
+class IntersectOrDiffPlan : public Iterator
+{
+public:
+	const Table *schema() override
+	{
+		return _left->schema();
+	}
+
+	void open() override
+	{
+		_right_values.clear();
+		_right->open();
+		for (Row *row = _right->next(); row != NULL; row = _right->next())
+			_right_values.insert(row->data());
+		_right->close();
+		_left->open();
+	}
+
+	Row *next() override
+	{
+		Row *row;
+		while ((row = _left->next()) != NULL &&
+			   (_right_values.find(row->data()) != _right_values.end()) != _keep_matches)
+			;
+		return row;
+	}
+
+	void close() override
+	{
+		_left->close();
+		_right_values.clear();
+	}
+
+	IntersectOrDiffPlan(Iterator *left, Iterator *right, bool keep_matches)
+		: _left(left),
+		  _right(right),
+		  _keep_matches(keep_matches)
+	{}
+
+	~IntersectOrDiffPlan()
+	{
+		delete _left;
+		delete _right;
+	}
+
+private:
+	Iterator *_left;
+	Iterator *_right;
+	bool _keep_matches;
+	ValuesSet _right_values;
+};
+
+// Base class of product and join: the right input is read into memory by open, and the left input is streamed.
+// Each left row is combined with the right rows that match it.
+class CombinePlan : public RowBuilder
+{
+public:
+	const Table *schema() override
+	{
+		return _schema;
+	}
+
+	void open() override
+	{
+		_right_rows.clear();
+		_right->open();
+		for (Row *row = _right->next(); row != NULL; row = _right->next())
+			add_right_row(*row);
+		_right->close();
+		_left->open();
+		_left_row = NULL;
+		_matches = NULL;
+		_match = 0;
+	}
+
+	Row *next() override
+	{
+		while (_matches == NULL || _match == _matches->size()) {
+			_left_row = _left->next();
+			if (_left_row == NULL) {
+				_matches = NULL;
+				return NULL;
+			}
+			_matches = matches(_left_row);
+			_match = 0;
+		}
+		Row *row = new_row(_schema);
+		for (const string &value : _left_row->data())
+			row->append(value);
+		const Row &right_row = _matches->at(_match++);
+		for (unsigned int k = 0; k < _right_other_positions.size(); k++)
+			row->append(right_row.at(_right_other_positions[k]));
+		return row;
+	}
+
+	void close() override
+	{
+		_left->close();
+		_right_rows.clear();
+		_matches = NULL;
+		discard_row();
+	}
+
+	~CombinePlan()
+	{
+		delete _left;
+		delete _right;
+	}
+
+protected:
+	CombinePlan(Iterator *left, Iterator *right, const Table *schema, const vector<unsigned> &right_other_positions)
+		: _left(left),
+		  _right(right),
+		  _schema(schema),
+		  _right_other_positions(right_other_positions),
+		  _left_row(NULL),
+		  _matches(NULL),
+		  _match(0)
+	{}
+
+	// Keep a row of the right input. The copy shares the row's values.
+	virtual void add_right_row(const Row &row) = 0;
+
+	// The kept right rows matching a row of the left input, (or NULL if there are none)
+	virtual const vector<Row> *matches(Row *left_row) = 0;
+
+	// Right rows, grouped by join key. A product has a single group, with an empty key.
+	unordered_map<vector<string>, vector<Row>, ValuesHash> _right_rows;
+
+private:
+	Iterator *_left;
+	Iterator *_right;
+	const Table *_schema;
+	vector<unsigned> _right_other_positions;
+	Row *_left_row;
+	const vector<Row> *_matches;
+	size_t _match;
+};
+
+class ProductPlan : public CombinePlan
+{
+public:
+	ProductPlan(Iterator *left, Iterator *right, const Table *schema)
+		: CombinePlan(left, right, schema, all_positions(right->n_columns()))
+	{}
+
+protected:
+	void add_right_row(const Row &row) override
+	{
+		_right_rows[vector<string>()].emplace_back(row);
+	}
+
+	const vector<Row> *matches(Row *left_row) override
+	{
+		auto group = _right_rows.find(vector<string>());
+		return group == _right_rows.end() ? NULL : &group->second;
+	}
+
+private:
+	static vector<unsigned> all_positions(unsigned n)
+	{
+		vector<unsigned> positions;
+		for (unsigned i = 0; i < n; i++)
+			positions.push_back(i);
+		return positions;
+	}
+};
+
+class JoinPlan : public CombinePlan
+{
+public:
+	JoinPlan(Iterator *left, Iterator *right, const Table *schema,
+			 const vector<unsigned> &left_positions, const vector<unsigned> &right_positions,
+			 const vector<unsigned> &right_other_positions)
+		: CombinePlan(left, right, schema, right_other_positions),
+		  _left_positions(left_positions),
+		  _right_positions(right_positions)
+	{}
+
+protected:
+	void add_right_row(const Row &row) override
+	{
+		joinKey(row, _right_positions, _key);
+		_right_rows[_key].emplace_back(row);
+	}
+
+	const vector<Row> *matches(Row *left_row) override
+	{
+		joinKey(*left_row, _left_positions, _key);
+		auto group = _right_rows.find(_key);
+		return group == _right_rows.end() ? NULL : &group->second;
+	}
+
+private:
+	vector<unsigned> _left_positions;
+	vector<unsigned> _right_positions;
+	vector<string> _key;
+};
+
+// The root of a compiled plan, owning the expression that the plan's operators refer to
+class CompiledPlan : public Iterator
+{
+public:
+	const Table *schema() override
+	{
+		return _plan->schema();
+	}
+
+	void open() override
+	{
+		_plan->open();
+	}
+
+	Row *next() override
+	{
+		return _plan->next();
+	}
+
+	void close() override
+	{
+		_plan->close();
+	}
+
+	CompiledPlan(Expression *expression)
+		: _expression(expression),
+		  _plan(expression->plan())
+	{}
+
+	~CompiledPlan()
+	{
+		delete _plan;
+		delete _expression;
+	}
+
+private:
+	Expression *_expression;
+	Iterator *_plan;
+};
+
+//----------------------------------------------------------------------
+
+// Factories
+
+Iterator *compile(Expression *e)
+{
+	try {
+		return new CompiledPlan(e);
+	}
+	catch (...) {
+		delete e;
+		throw;
+	}
+}
+
+Table *materialize(Iterator *plan)
+{
+	Table *result = Database::new_table(Database::new_table_name(), plan->schema()->columns());
+	plan->open();
+	for (Row *row = plan->next(); row != NULL; row = plan->next()) {
+		Row *copy = new Row(result, *row);
+		if (!result->add(copy))
+			delete copy;
+	}
+	plan->close();
+	return result;
+}
+
+Iterator *scan_plan(Table *table)
+{
+	return new ScanPlan(table);
+}
+
+Iterator *select_plan(Iterator *input, RowPredicate predicate)
+{
+	return new SelectPlan(input, predicate);
+}
+
+Iterator *project_plan(Iterator *input, const Table *schema, const vector<unsigned> &positions)
+{
+	return new ProjectPlan(input, schema, positions);
+}
+
+Iterator *rename_plan(Iterator *input, const Table *schema)
+{
+	return new RenamePlan(input, schema);
+}
+
+Iterator *distinct_plan(Iterator *input)
+{
+	return new DistinctPlan(input);
+}
+
+Iterator *union_plan(Iterator *left, Iterator *right)
+{
+	return new UnionPlan(left, right);
+}
+
+Iterator *intersect_or_diff_plan(Iterator *left, Iterator *right, bool keep_matches)
+{
+	return new IntersectOrDiffPlan(left, right, keep_matches);
+}
+
+Iterator *product_plan(Iterator *left, Iterator *right, const Table *schema)
+{
+	return new ProductPlan(left, right, schema);
+}
+
+Iterator *join_plan(Iterator *left, Iterator *right, const Table *schema,
+					const vector<unsigned> &left_positions, const vector<unsigned> &right_positions,
+					const vector<unsigned> &right_other_positions)
+{
+	return new JoinPlan(left, right, schema, left_positions, right_positions, right_other_positions);
+}
@@ -0,0 +1,68 @@
+#ifndef RA_PLAN_H
+#define RA_PLAN_H
+
+#include "Expression.h"
+
+// A pipelined plan for a relational algebra expression: a tree of iterators, with the protocol of the
+// QueryIterator module's Iterator, (open, next until it returns NULL, close, and then possibly open again).
+// Rows stream through the operators one at a time: only the right inputs of joins, products, intersections and
+// differences are held in memory, (in hash tables), along with the rows seen by the duplicate eliminations.
+//
+// Column names are mapped to positions when the plan is compiled. Duplicates are eliminated only where set
+// semantics require it: after a projection, (which can map distinct rows to the same row), and after a union,
+// (whose inputs can share rows). Every other operator produces distinct rows from distinct inputs.
+//
+// The QueryIterator and RelationalAlgebra modules each have their own Row, Table and Database classes, so they
+// can't be linked into one program. This is the QueryIterator execution model, implemented on the relational
+// algebra module's rows and tables.
+class Iterator
+{
+public:
+    // The table that the rows returned by next belong to, (and whose columns they have)
+    virtual const Table *schema() = 0;
+
+    unsigned n_columns();
+
+    virtual void open() = 0;
+
+    // The next row, or NULL if there are no more. The row is owned by the plan, and is valid until the next call
+    // of next or close, (but Row(table, row) can share its values).
+    virtual Row *next() = 0;
+
+    virtual void close() = 0;
+
+    virtual ~Iterator();
+};
+
+// Compile e into a plan, which takes ownership of e.
+Iterator *compile(Expression *e);
+
+// Run the plan, returning a new table in the Database, containing its rows.
+Table *materialize(Iterator *plan);
+
+// The operators of plans, used by Expression::plan. Each one takes ownership of its inputs. Operators with a
+// schema argument produce rows of that table, (which must outlive the operator).
+
+Iterator *scan_plan(Table *table);
+
+Iterator *select_plan(Iterator *input, RowPredicate predicate);
+
+Iterator *project_plan(Iterator *input, const Table *schema, const vector<unsigned> &positions);
+
+Iterator *rename_plan(Iterator *input, const Table *schema);
+
+Iterator *distinct_plan(Iterator *input);
+
+Iterator *union_plan(Iterator *left, Iterator *right);
+
+// The rows of left that are in right, if keep_matches is true, or that are not in right, otherwise.
+Iterator *intersect_or_diff_plan(Iterator *left, Iterator *right, bool keep_matches);
+
+Iterator *product_plan(Iterator *left, Iterator *right, const Table *schema);
+
+// The output rows have all of left's values, followed by those of right's at right_other_positions.
+Iterator *join_plan(Iterator *left, Iterator *right, const Table *schema,
+                    const vector<unsigned> &left_positions, const vector<unsigned> &right_positions,
+                    const vector<unsigned> &right_other_positions);
+
+#endif //RA_PLAN_H
@@ -1,4 +1,6 @@
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <cstring>
 #include "RelationalAlgebra.h"
 #include "Database.h"
@@ -8,6 +10,7 @@ bool unionCompatible(Table *r, Table *s);
 bool disjointColumnsNames_Check(Table *r, Table *s);
 NameMap namemapCreate(Table *t);
 bool addRow(Table *table, const vector<string>& values);
+ColumnNames renamedColumns(const ColumnNames &columns, const NameMap &name_map);
 
 //Union-compatible detect
 bool unionCompatible(Table *r, Table *s)
@@ -69,21 +72,81 @@ bool addRow(Table *table, const vector<string>& values)
 	}
 }
 
+// Compare rows of union-compatible tables, column by column, as RowCompare orders the rows of each table.
+// Columns are matched by position, so the tables' column names may differ.
+static int compareRows(Row *x, Row *y)
+{
+	for (unsigned int i = 0; i < x->size(); i++) {
+		int comparison = strcmp(x->at(i).c_str(), y->at(i).c_str());
+		if (comparison != 0)
+			return comparison;
+	}
+	return 0;
+}
+
+// mergeRows for inputs that aren't both ordered: look up the rows of r among the values of s's rows.
+static Table *hashRows(Table *result, Table *r, Table *s, bool rOnly, bool both, bool sOnly)
+{
+	unordered_set<vector<string>, ValuesHash> sValues;
+	RowSet::const_iterator it;
+	for (it = s->rows().begin(); it != s->rows().end(); it++) {
+		sValues.insert((*it)->data());
+		if (sOnly)
+			addRow(result, (*it)->data());
+	}
+	for (it = r->rows().begin(); it != r->rows().end(); it++) {
+		bool inS = sValues.find((*it)->data()) != sValues.end();
+		if (inS ? both && !sOnly : rOnly)
+			addRow(result, (*it)->data());
+	}
+	return result;
+}
+
+// Merge the rows of r and s, which are both in RowCompare order, in one pass. Rows only in r, in both, and only
+// in s are added to result if the corresponding flag is set. The rows are added in order, so each add is an
+// append. (If either table keeps its rows in a hash set, they are not in order, and hashRows does the work.)
+static Table *mergeRows(Table *r, Table *s, bool rOnly, bool both, bool sOnly)
+{
+	Table *result = Database::new_table(Database::new_table_name(), r->columns());
+	if (!r->rows().ordered() || !s->rows().ordered())
+		return hashRows(result, r, s, rOnly, both, sOnly);
+	RowSet::const_iterator it_r = r->rows().begin();
+	RowSet::const_iterator it_s = s->rows().begin();
+	RowSet::const_iterator end_r = r->rows().end();
+	RowSet::const_iterator end_s = s->rows().end();
+	while (it_r != end_r && it_s != end_s) {
+		int comparison = compareRows(*it_r, *it_s);
+		if (comparison < 0) {
+			if (rOnly)
+				addRow(result, (*it_r)->data());
+			it_r++;
+		}
+		else if (comparison > 0) {
+			if (sOnly)
+				addRow(result, (*it_s)->data());
+			it_s++;
+		}
+		else {
+			if (both)
+				addRow(result, (*it_r)->data());
+			it_r++;
+			it_s++;
+		}
+	}
+	for (; rOnly && it_r != end_r; it_r++)
+		addRow(result, (*it_r)->data());
+	for (; sOnly && it_s != end_s; it_s++)
+		addRow(result, (*it_s)->data());
+	return result;
+}
+
 Table *onion(Table *r, Table *s)
 {
 	// Check if union compatible
 	if (!unionCompatible(r, s))
 		throw UnionIncompatibilityException("Tables have different columns.");
 
-	Table *result = Database::new_table(Database::new_table_name(), r->columns());
-	set<Row*, RowCompare>::iterator it;
-
-	// Correct cases
-	for (it = r->rows().begin(); it != r->rows().end(); it++)
-		addRow(result, (*it)->data());
-	for (it = s->rows().begin(); it != s->rows().end(); it++)
-		addRow(result, (*it)->data());
-	return result;
+	return mergeRows(r, s, true, true, true);
 }
 
 Table *intersect(Table *r, Table *s)
@@ -92,15 +155,7 @@ Table *intersect(Table *r, Table *s)
 	if (!unionCompatible(r, s))
 		throw UnionIncompatibilityException("Two tables are not union compatible");
 
-	Table* result = Database::new_table(Database::new_table_name(), r->columns());
-	set<Row*, RowCompare>::iterator it;
-	RowSet sRows = s->rows();
-
-	// Correct cases
-	for (it = r->rows().begin(); it != r->rows().end(); it++)
-		if (sRows.find(*it) != sRows.end())
-			addRow(result, (*it)->data());
-	return result;
+	return mergeRows(r, s, false, true, false);
 }
 
 Table *diff(Table *r, Table *s)
@@ -109,15 +164,7 @@ Table *diff(Table *r, Table *s)
 	if (!unionCompatible(r, s))
 		throw UnionIncompatibilityException("Two tables are not union compatible");
 
-	Table* result = Database::new_table(Database::new_table_name(), r->columns());
-	set<Row*, RowCompare>::iterator it;
-	RowSet sRows = s->rows();
-
-	// Correct cases
-	for (it = r->rows().begin(); it != r->rows().end(); it++)
-		if (sRows.find(*it) == sRows.end())
-			addRow(result, (*it)->data());
-	return result;
+	return mergeRows(r, s, true, false, false);
 }
 
 Table *product(Table *r, Table *s)
@@ -129,8 +176,8 @@ Table *product(Table *r, Table *s)
 	Table *r_rename = rename(r, namemapCreate(r));
 	Table *s_rename = rename(s, namemapCreate(s));
 	ColumnNames newColumnNames = r_rename->columns();
-	set<Row*, RowCompare>::iterator it_r;
-	set<Row*, RowCompare>::iterator it_s;
+	RowSet::const_iterator it_r;
+	RowSet::const_iterator it_s;
 
 	// New table and columnnames
 	newColumnNames.insert(newColumnNames.end(), s_rename->columns().begin(), s_rename->columns().end());
@@ -147,12 +194,17 @@ Table *product(Table *r, Table *s)
 			addRow(result, temp);
 		}
 	}
+	// Nothing else refers to the renamed inputs.
+	Database::drop_table(r_rename);
+	Database::drop_table(s_rename);
 	return result;
 }
 
-Table *rename(Table *r, const NameMap &name_map)
+// The columns of a table with the given columns, renamed according to name_map. Throws TableException as rename
+// does.
+ColumnNames renamedColumns(const ColumnNames &columns, const NameMap &name_map)
 {
-	ColumnNames rColoumnNames = r->columns();
+	ColumnNames rColoumnNames = columns;
 
 	// Check if renaming a column more than once
 	set<string> test;
@@ -168,7 +220,7 @@ Table *rename(Table *r, const NameMap &name_map)
 		for (auto it = name_map.begin(); it != name_map.end(); it++) {
 			bool isFound = false;
 			for (unsigned int i = 0; i < rColoumnNames.size(); i++) {
-				if (it->first == rColoumnNames[i]) {
+				if (it->first == columns[i]) {
 					isFound = true;
 					rColoumnNames[i] = it->second;
 				}
@@ -177,17 +229,26 @@ Table *rename(Table *r, const NameMap &name_map)
 				throw TableException("Can not rename columns that don't exist");
 		}
 	}
+	return rColoumnNames;
+}
+
+Table *rename(Table *r, const NameMap &name_map)
+{
+	ColumnNames rColoumnNames = renamedColumns(r->columns(), name_map);
+
+	// Only the column names change: the new rows share the values of r's rows, and are added in r's order,
+	// (which is also their order in the result), so each add is an append.
 	Table* result = Database::new_table(Database::new_table_name(), rColoumnNames);
-	set<Row*, RowCompare>::iterator it_set;
+	RowSet::const_iterator it_set;
 	for (it_set = r->rows().begin(); it_set != r->rows().end(); it_set++)
-		addRow(result, (*it_set)->data());
+		result->add(new Row(result, **it_set));
 	return result;
 }
 
 Table *select(Table *r, RowPredicate predicate)
 {
 	Table* result = Database::new_table(Database::new_table_name(), r->columns());
-	set<Row*, RowCompare>::iterator it;
+	RowSet::const_iterator it;
 	for (it = r->rows().begin(); it != r->rows().end(); it++)
 		if (predicate(*it))
 			addRow(result, (*it)->data());
@@ -212,72 +273,86 @@ Table *project(Table *r, const ColumnNames &columns)
 		}
 
 	// Correct cases
+	vector<ColumnHandle> handles;
+	for (unsigned int i = 0; i < columns.size(); i++)
+		handles.push_back(ColumnHandle(r->columns(), columns[i]));
 	Table* result = Database::new_table(Database::new_table_name(), columns);
-	set<Row*, RowCompare>::iterator it;
+	RowSet::const_iterator it;
+	vector<string> temp;
 	for (it = r->rows().begin(); it != r->rows().end(); it++) {
-		vector<string> *temp = new vector<string>;
-		for (unsigned int i = 0; i < columns.size(); i++)
-			temp->push_back((*it)->value(columns[i]));
-		addRow(result, *temp);
-		delete temp;
+		temp.clear();
+		for (unsigned int i = 0; i < handles.size(); i++)
+			temp.push_back((*it)->value(handles[i]));
+		addRow(result, temp);
 	}
 	return result;
 }
 
+typedef unordered_map<vector<string>, vector<Row*>, ValuesHash> JoinHashTable;
+
 Table *join(Table *r, Table *s)
 {
-	// Get join columns and same columns
+	// Resolve the common columns, and the remaining columns of s, to positions once
+	vector<unsigned> rJoinPositions;
+	vector<unsigned> sJoinPositions;
+	vector<unsigned> sOtherPositions;
 	ColumnNames joinColumns_for_s;
-	vector<string> sameColumns;
-	unsigned int count = 0;
-
-	for (unsigned j = 0; j < s->columns().size(); j++) {
-		bool isSame = false;
-		for (unsigned i = 0; i < r->columns().size(); i++) {
-			if (s->columns()[j] == r->columns()[i]) {
-				isSame = true;
-				sameColumns.push_back(s->columns()[j]);
-				count++;
-				break;
-			}
+	const ColumnNames& rColumns = r->columns();
+	const ColumnNames& sColumns = s->columns();
+
+	for (unsigned j = 0; j < sColumns.size(); j++) {
+		int i = rColumns.position(sColumns[j]);
+		if (i != -1) {
+			rJoinPositions.push_back((unsigned) i);
+			sJoinPositions.push_back(j);
+		}
+		else {
+			sOtherPositions.push_back(j);
+			joinColumns_for_s.push_back(sColumns[j]);
 		}
-		if (!isSame)
-			joinColumns_for_s.push_back(s->columns()[j]);
 	}
 
 	// Check if have no columns in common
-	if (count == 0) {
+	if (rJoinPositions.empty()) {
 		throw JoinException("Have no columns in common");
 		return Database::new_table(Database::new_table_name(), {});
 	}
 
 	// Correct cases
-	ColumnNames newColumnsName = r->columns();
+	ColumnNames newColumnsName = rColumns;
 	newColumnsName.insert(newColumnsName.end(), joinColumns_for_s.begin(), joinColumns_for_s.end());
 	Table* result = Database::new_table(Database::new_table_name(), newColumnsName);
 
-	set<Row*, RowCompare>::iterator it_r;
-	set<Row*, RowCompare>::iterator it_s;
-	for (it_r = r->rows().begin(); it_r != r->rows().end(); it_r++) {
-		for (it_s = s->rows().begin(); it_s != s->rows().end(); it_s++) {
-			bool isAllsame = true;
-			for (unsigned int i = 0; i < sameColumns.size(); i++) {
-				if ((*it_r)->value(sameColumns[i]) == (*it_s)->value(sameColumns[i]) && isAllsame == true)
-					continue;
-				else {
-					isAllsame = false;
-					break;
-				}
-			}
-			if (isAllsame) {
-				vector<string> *temp = new vector<string>;
-				temp->insert(temp->end(), (*it_r)->data().begin(), (*it_r)->data().end());
-				for (unsigned int k = 0; k < joinColumns_for_s.size(); k++)
-					temp->push_back((*it_s)->value(joinColumns_for_s[k]));
-				addRow(result, *temp);
-				delete temp;
-			}
+	// Hash the smaller input on the join columns, and probe with each row of the other
+	bool buildR = r->rows().size() <= s->rows().size();
+	Table *build = buildR ? r : s;
+	Table *probe = buildR ? s : r;
+	const vector<unsigned>& buildPositions = buildR ? rJoinPositions : sJoinPositions;
+	const vector<unsigned>& probePositions = buildR ? sJoinPositions : rJoinPositions;
+
+	JoinHashTable hashTable;
+	hashTable.reserve(build->rows().size());
+	vector<string> key;
+	RowSet::const_iterator it;
+	for (it = build->rows().begin(); it != build->rows().end(); it++) {
+		joinKey(**it, buildPositions, key);
+		hashTable[key].push_back(*it);
+	}
+
+	vector<string> temp;
+	for (it = probe->rows().begin(); it != probe->rows().end(); it++) {
+		joinKey(**it, probePositions, key);
+		JoinHashTable::const_iterator match = hashTable.find(key);
+		if (match == hashTable.end())
+			continue;
+		for (unsigned int m = 0; m < match->second.size(); m++) {
+			Row *rRow = buildR ? match->second[m] : *it;
+			Row *sRow = buildR ? *it : match->second[m];
+			temp.assign(rRow->data().begin(), rRow->data().end());
+			for (unsigned int k = 0; k < sOtherPositions.size(); k++)
+				temp.push_back(sRow->at(sOtherPositions[k]));
+			addRow(result, temp);
 		}
 	}
 	return result;
-}
\ No newline at end of file
+}
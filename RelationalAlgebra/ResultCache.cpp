@@ -0,0 +1,107 @@
+#include "ResultCache.h"
+#include "Database.h"
+#include "Plan.h"
+
+shared_ptr<const Table> ResultCache::get(Expression *e, const vector<string> &parameters)
+{
+	string key;
+	vector<const Table *> tables;
+	try {
+		e->canonical(key, tables);
+	}
+	catch (...) {
+		delete e;
+		throw;
+	}
+	key += '(';
+	for (const string &parameter : parameters) {
+		key += to_string(parameter.size());
+		key += ':';
+		key += parameter;
+	}
+	key += ')';
+	auto found = _entries.find(key);
+	if (found != _entries.end()) {
+		if (valid(found->second)) {
+			_hits++;
+			_lru.splice(_lru.begin(), _lru, found->second.lru_position);
+			delete e;
+			return found->second.result;
+		}
+		discard(found);
+	}
+	_misses++;
+	shared_ptr<const Table> result = run(e);
+	Entry entry;
+	for (const Table *table : tables) {
+		if (Database::table(table->name()) != table)
+			return result;
+		entry.inputs.push_back({table->name(), table->id(), table->version()});
+	}
+	if (_capacity == 0)
+		return result;
+	if (_entries.size() == _capacity)
+		discard(_entries.find(_lru.back()));
+	entry.result = result;
+	_lru.push_front(key);
+	entry.lru_position = _lru.begin();
+	_entries.emplace(key, entry);
+	return result;
+}
+
+size_t ResultCache::size() const
+{
+	return _entries.size();
+}
+
+unsigned long ResultCache::hits() const
+{
+	return _hits;
+}
+
+unsigned long ResultCache::misses() const
+{
+	return _misses;
+}
+
+void ResultCache::clear()
+{
+	_entries.clear();
+	_lru.clear();
+}
+
+ResultCache::ResultCache(size_t capacity)
+	: _capacity(capacity),
+	  _hits(0),
+	  _misses(0)
+{}
+
+bool ResultCache::valid(const Entry &entry)
+{
+	for (const Input &input : entry.inputs) {
+		Table *table = Database::table(input.name);
+		if (table == NULL || table->id() != input.id || table->version() != input.version)
+			return false;
+	}
+	return true;
+}
+
+shared_ptr<const Table> ResultCache::run(Expression *e)
+{
+	unique_ptr<Iterator> plan(compile(e));
+	shared_ptr<Table> result = make_shared<Table>(Database::new_table_name(), plan->schema()->columns());
+	plan->open();
+	for (Row *row = plan->next(); row != NULL; row = plan->next()) {
+		Row *copy = new Row(result.get(), *row);
+		if (!result->add(copy))
+			delete copy;
+	}
+	plan->close();
+	return result;
+}
+
+void ResultCache::discard(unordered_map<string, Entry>::iterator entry)
+{
+	_lru.erase(entry->second.lru_position);
+	_entries.erase(entry);
+}
@@ -0,0 +1,71 @@
+#ifndef RA_RESULTCACHE_H
+#define RA_RESULTCACHE_H
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include "Expression.h"
+
+// A cache of query results, for queries that are repeated against tables that rarely change. Results are keyed by
+// the canonical form of the query's expression, (see Expression::canonical), together with its parameters: the
+// values that its predicates read, other than the rows, (e.g. the user id of "send dates for user X"). A result is
+// valid as long as the tables that the query reads keep the versions they had when it was computed, (see
+// Table::version). Stale results are discarded when they are next looked up, and the least recently used result
+// is discarded when the cache is full.
+//
+// Results are tables that are not in the Database, shared by the cache and the callers that got them, so a result
+// stays valid for a caller after the cache has discarded it.
+class ResultCache
+{
+public:
+    // The result of e, computed by running its plan, (see Plan.h), unless the cache has a valid result for the same
+    // expression and parameters. e is deleted. Results of expressions reading tables that are not in the Database
+    // are not cached.
+    shared_ptr<const Table> get(Expression *e, const vector<string> &parameters = vector<string>());
+
+    // The number of results in the cache
+    size_t size() const;
+
+    // The number of calls of get that found a valid result, and that didn't
+    unsigned long hits() const;
+    unsigned long misses() const;
+
+    // Discard all results.
+    void clear();
+
+    // A cache holding at most capacity results
+    explicit ResultCache(size_t capacity = 64);
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+private:
+    // A table read by a cached query, and its version when the query ran. Tables are identified by name and id,
+    // rather than by address, so that a dropped table is detected.
+    struct Input
+    {
+        string name;
+        unsigned long id;
+        unsigned long version;
+    };
+
+    struct Entry
+    {
+        shared_ptr<const Table> result;
+        vector<Input> inputs;
+        list<string>::iterator lru_position;
+    };
+
+    static bool valid(const Entry &entry);
+    static shared_ptr<const Table> run(Expression *e);
+    void discard(unordered_map<string, Entry>::iterator entry);
+
+private:
+    size_t _capacity;
+    unordered_map<string, Entry> _entries;
+    list<string> _lru;              // Keys of _entries, most recently used first
+    unsigned long _hits;
+    unsigned long _misses;
+};
+
+#endif //RA_RESULTCACHE_H
@@ -27,7 +27,7 @@ const Table *Row::table() const
 
 const vector<string> &Row::data() const
 {
-	return _values;
+	return *_values;
 }
 
 const string &Row::value(const string &column) const
@@ -35,16 +35,21 @@ const string &Row::value(const string &column) const
 	int pos = _table->columns().position(column);
 	// Check if value found or not
 	if (pos != -1)
-		return _values[pos];
+		return (*_values)[pos];
 	else
 		throw TableException("Value not found");
 	//return *new string("");
 }
 
+const string &Row::value(const ColumnHandle &column) const
+{
+	return (*_values)[column.position()];
+}
+
 const string &Row::at(unsigned i) const
 {
-	if (i >= 0 && i <= _values.size() - 1)
-		return _values[i];
+	if (i >= 0 && i <= _values->size() - 1)
+		return (*_values)[i];
 	else
 		throw TableException("There is no certain column in this row");
 }
@@ -52,8 +57,11 @@ const string &Row::at(unsigned i) const
 void Row::append(const string &value)
 {
 	// Check if number of columns is out of bound before adding new data
-	if (_table->columns().size() > _values.size()) {
-		_values.push_back(value);
+	if (_table->columns().size() > _values->size()) {
+		// Copy values shared with another row before changing them
+		if (_values.use_count() > 1)
+			_values = make_shared<vector<string>>(*_values);
+		_values->push_back(value);
 	}
 	else
 		throw TableException("Too many columns to add");
@@ -61,15 +69,18 @@ void Row::append(const string &value)
 
 unsigned long Row::size() const
 {
-	return _values.size();
+	return _values->size();
 }
 
 Row::Row(const Table *table)
-        : _table(table)
+        : _table(table),
+          _values(make_shared<vector<string>>())
+{}
+
+Row::Row(const Table *table, const Row &source)
+        : _table(table),
+          _values(source._values)
 {}
 
 Row::~Row()
-{
-	vector<string>().swap(_values);
-	_values.clear();
-}
\ No newline at end of file
+{}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef RA_C_ROW_H
 #define RA_C_ROW_H
 
+#include <memory>
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 using namespace std;
 
 class Table;
+class ColumnHandle;
 
 class Row
 {
@@ -25,6 +27,9 @@ public:
     // The value for the given column in this Row
     const string &value(const string &column) const;
 
+    // The value for the column of the given handle, (which must be resolved in the columns of this Row's table)
+    const string &value(const ColumnHandle &column) const;
+
     // The value for the ith column in this Row.
     const string &at(unsigned i) const;
 
@@ -37,12 +42,16 @@ public:
     // Create a Row for the given Table
     Row(const Table *table);
 
+    // Create a Row for the given Table, sharing the values of source, (e.g. for a renamed table). The values
+    // are copied only if either row is appended to later.
+    Row(const Table *table, const Row &source);
+
     // Destroy this Row
     ~Row();
 
 private:
     const Table *_table;
-    vector<string> _values;
+    shared_ptr<vector<string>> _values;
 };
 
 #endif //RA_C_ROW_H
@@ -1,15 +1,38 @@
 #include <cstring>
+#include <functional>
 #include "RowCompare.h"
 #include "Row.h"
 #include "Table.h"
 
-int RowCompare::operator()(Row* const &x, Row* const &y)
+int RowCompare::operator()(Row* const &x, Row* const &y) const
 {
-    for (const string &column : x->table()->columns()) {
-        int comparison = strcmp(x->value(column).c_str(), y->value(column).c_str());
+    const ColumnNames &columns = x->table()->columns();
+    bool same_table = x->table() == y->table();
+    unsigned long n = columns.size();
+    for (unsigned i = 0; i < n; i++) {
+        // Rows of the same table have the same column positions. Otherwise, y's column is found by name.
+        const string &y_value = same_table ? y->at(i) : y->value(columns.at(i));
+        int comparison = strcmp(x->at(i).c_str(), y_value.c_str());
         if (comparison != 0) {
             return comparison < 0;
         }
     }
     return 0;
 }
+
+size_t ValuesHash::operator()(const vector<string> &values) const
+{
+    size_t h = 0;
+    for (const string &value : values) {
+        h = h * 31 + hash<string>()(value);
+    }
+    return h;
+}
+
+void joinKey(const Row &row, const vector<unsigned> &positions, vector<string> &key)
+{
+    key.clear();
+    for (unsigned position : positions) {
+        key.push_back(row.at(position));
+    }
+}
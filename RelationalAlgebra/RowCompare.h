@@ -1,12 +1,27 @@
 #ifndef RA_ROWCOMPARE_H
 #define RA_ROWCOMPARE_H
 
+#include <string>
+#include <vector>
+
+using namespace std;
+
 class Row;
 
 class RowCompare
 {
 public:
-    int operator()(Row* const &x, Row* const &y);
+    int operator()(Row* const &x, Row* const &y) const;
 };
 
+// Hashes a list of values, (e.g. a row's values, or a join key), for hash joins and hash sets.
+class ValuesHash
+{
+public:
+    size_t operator()(const vector<string> &values) const;
+};
+
+// Sets key to the row's values at the given positions, (e.g. its join columns), for hashing with ValuesHash.
+void joinKey(const Row &row, const vector<unsigned> &positions, vector<string> &key);
+
 #endif //RA_ROWCOMPARE_H
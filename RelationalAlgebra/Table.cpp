@@ -1,8 +1,250 @@
+#include <algorithm>
 #include <cstring>
 #include "Database.h"
 
 using namespace std;
 
+size_t RowHash::operator()(Row* const &row) const
+{
+	return ValuesHash()(row->data());
+}
+
+bool RowEqual::operator()(Row* const &x, Row* const &y) const
+{
+	return x->data() == y->data();
+}
+
+// The memory held by a row, and its values
+static size_t row_bytes(Row *row)
+{
+	size_t bytes = sizeof(Row) + sizeof(vector<string>) + row->size() * sizeof(string);
+	for (const string &value : row->data())
+		bytes += value.size();
+	return bytes;
+}
+
+// RowCompare order for rows of the same table, comparing values by position rather than by column name
+static bool rowLess(Row* const &x, Row* const &y)
+{
+	const vector<string> &xValues = x->data();
+	const vector<string> &yValues = y->data();
+	for (unsigned int i = 0; i < xValues.size(); i++) {
+		int comparison = strcmp(xValues[i].c_str(), yValues[i].c_str());
+		if (comparison != 0)
+			return comparison < 0;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------
+
+// RowSet
+
+Row* const& RowSet::const_iterator::operator*() const
+{
+	switch (_kind) {
+	case TREE:
+		return *_tree;
+	case HASH:
+		return *_hash;
+	default:
+		return *_sorted;
+	}
+}
+
+RowSet::const_iterator& RowSet::const_iterator::operator++()
+{
+	switch (_kind) {
+	case TREE:
+		_tree++;
+		break;
+	case HASH:
+		_hash++;
+		break;
+	default:
+		_sorted++;
+	}
+	return *this;
+}
+
+RowSet::const_iterator RowSet::const_iterator::operator++(int)
+{
+	const_iterator before = *this;
+	++*this;
+	return before;
+}
+
+bool RowSet::const_iterator::operator==(const const_iterator& that) const
+{
+	switch (_kind) {
+	case TREE:
+		return _tree == that._tree;
+	case HASH:
+		return _hash == that._hash;
+	default:
+		return _sorted == that._sorted;
+	}
+}
+
+bool RowSet::const_iterator::operator!=(const const_iterator& that) const
+{
+	return !operator==(that);
+}
+
+RowSet::Kind RowSet::kind() const
+{
+	return _kind;
+}
+
+bool RowSet::ordered() const
+{
+	return _kind != HASH;
+}
+
+size_t RowSet::size() const
+{
+	switch (_kind) {
+	case TREE:
+		return _tree.size();
+	case HASH:
+		return _hash.size();
+	default:
+		return _sorted.size() + _batch.size();
+	}
+}
+
+bool RowSet::empty() const
+{
+	return size() == 0;
+}
+
+RowSet::const_iterator RowSet::begin() const
+{
+	const_iterator it;
+	it._kind = _kind;
+	if (_kind == TREE)
+		it._tree = _tree.begin();
+	else if (_kind == HASH)
+		it._hash = _hash.begin();
+	else {
+		merge_batch();
+		it._sorted = _sorted.begin();
+	}
+	return it;
+}
+
+RowSet::const_iterator RowSet::end() const
+{
+	const_iterator it;
+	it._kind = _kind;
+	if (_kind == TREE)
+		it._tree = _tree.end();
+	else if (_kind == HASH)
+		it._hash = _hash.end();
+	else {
+		merge_batch();
+		it._sorted = _sorted.end();
+	}
+	return it;
+}
+
+bool RowSet::insert(Row* row)
+{
+	switch (_kind) {
+	case TREE: {
+		// Hinting the end makes adding rows in order, (as the set operators do), constant time per row. Other
+		// rows are inserted as without the hint.
+		size_t n = _tree.size();
+		_tree.insert(_tree.end(), row);
+		return _tree.size() != n;
+	}
+	case HASH:
+		return _hash.insert(row).second;
+	default:
+		if (!_members.insert(row).second)
+			return false;
+		_batch.push_back(row);
+		return true;
+	}
+}
+
+Row* RowSet::find(Row* row) const
+{
+	switch (_kind) {
+	case TREE: {
+		auto it = _tree.find(row);
+		return it == _tree.end() ? NULL : *it;
+	}
+	case HASH: {
+		auto it = _hash.find(row);
+		return it == _hash.end() ? NULL : *it;
+	}
+	default: {
+		auto it = _members.find(row);
+		return it == _members.end() ? NULL : *it;
+	}
+	}
+}
+
+Row* RowSet::erase(Row* row)
+{
+	Row* found = find(row);
+	if (found != NULL) {
+		if (_kind == TREE)
+			_tree.erase(found);
+		else if (_kind == HASH)
+			_hash.erase(found);
+		else {
+			merge_batch();
+			_members.erase(found);
+			_sorted.erase(lower_bound(_sorted.begin(), _sorted.end(), found, rowLess));
+		}
+	}
+	return found;
+}
+
+RowSet::RowSet(Kind kind)
+	: _kind(kind)
+{}
+
+// Sort the batch, and merge it into the sorted rows
+void RowSet::merge_batch() const
+{
+	if (_batch.empty())
+		return;
+	sort(_batch.begin(), _batch.end(), rowLess);
+	size_t n = _sorted.size();
+	_sorted.insert(_sorted.end(), _batch.begin(), _batch.end());
+	inplace_merge(_sorted.begin(), _sorted.begin() + n, _sorted.end(), rowLess);
+	_batch.clear();
+}
+
+//----------------------------------------------------------------------
+
+// NamedColumn
+
+const string &NamedColumn::value(const Row *row)
+{
+	const Table *table = row->table();
+	if (table->id() != _table_id) {
+		_position = ColumnHandle(table->columns(), _name).position();
+		_table_id = table->id();
+	}
+	return row->at(_position);
+}
+
+NamedColumn::NamedColumn(const string &name)
+	: _name(name),
+	  _table_id(0),
+	  _position(0)
+{}
+
+//----------------------------------------------------------------------
+
+// Table
+
+unsigned long Table::_last_id = 0;
+
 const string &Table::name() const
 {
     return _name;
@@ -13,12 +255,22 @@ const ColumnNames &Table::columns() const
     return _columns;
 }
 
-const RowSet& Table::rows()
+unsigned long Table::id() const
+{
+    return _id;
+}
+
+const RowSet& Table::rows() const
 {
 	return _rows;
     //return *new RowSet();
 }
 
+unsigned long Table::version() const
+{
+    return _version;
+}
+
 bool Table::add(Row* row)
 {
 	// Check if number of columns in new row is out of bound
@@ -31,27 +283,24 @@ bool Table::add(Row* row)
 		return false;
 	}
 	else {
-		pair<set<Row*, RowCompare>::iterator, bool> ret;
-		ret = _rows.insert(row);
-		if (ret.second == false)
+		if (!_rows.insert(row))
 			return false;
-		else
-			return true;
+		add_bytes((long) row_bytes(row));
+		_version++;
+		return true;
 	}
 }
 
 bool Table::remove(Row* row)
 {
 	if (row->data().size() == _columns.size()) {
-		set<Row*, RowCompare>::iterator it;
-		it = _rows.find(row);
-		if (it != _rows.end()) {             // Matching row is found
-			delete *it;
-			_rows.erase(it);                 // Remove the matching row
-			return true;
-		}
-		else
+		Row* removed = _rows.erase(row);         // Remove the matching row
+		if (removed == NULL)
 			return false;
+		add_bytes(-(long) row_bytes(removed));
+		delete removed;
+		_version++;
+		return true;
 	}
 	else
 		throw TableException("Can not remove incompatible row");
@@ -61,17 +310,31 @@ bool Table::remove(Row* row)
 bool Table::has(Row* row)
 {
 	if (row->data().size() == _columns.size())
-		if (_rows.find(row) != _rows.end())               // Matching row is found
-			return true;
-		else
-			return false;
+		return _rows.find(row) != NULL;       // Matching row is found
 	else
 		throw TableException("Can not have bad row");
 }
 
-Table::Table(const string &name, const ColumnNames &columns)
+size_t Table::bytes() const
+{
+	return _bytes;
+}
+
+void Table::add_bytes(long delta)
+{
+	_bytes += delta;
+	if (_scope != NULL)
+		_scope->add_bytes(delta);
+}
+
+Table::Table(const string &name, const ColumnNames &columns, RowSet::Kind kind)
     : _name(name),
-      _columns(columns)
+      _columns(columns),
+      _rows(kind),
+      _bytes(0),
+      _scope(NULL),
+      _id(++_last_id),
+      _version(0)
 {
 	// Check whether columns are empty or not
 	if (!columns.empty()) {
@@ -86,9 +349,8 @@ Table::Table(const string &name, const ColumnNames &columns)
 
 Table::~Table()
 {
-	set<Row*, RowCompare>::iterator it;
+	RowSet::const_iterator it;
 	for (it = _rows.begin(); it != _rows.end(); it++) {
 		delete *it;
 	}
-	_rows.clear();
 }
\ No newline at end of file
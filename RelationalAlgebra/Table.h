@@ -1,15 +1,130 @@
 #ifndef RA_C_TABLE_H
 #define RA_C_TABLE_H
 
+#include <iterator>
 #include <memory>
 #include <set>
+#include <unordered_set>
 #include "Row.h"
 #include "RowCompare.h"
 #include "ColumnNames.h"
 
 using namespace std;
 
-class RowSet: public set<Row*, RowCompare> {};
+// Hash and equality of rows by their values, for hash sets of rows
+class RowHash
+{
+public:
+    size_t operator()(Row* const &row) const;
+};
+
+class RowEqual
+{
+public:
+    bool operator()(Row* const &x, Row* const &y) const;
+};
+
+typedef unordered_set<Row*, RowHash, RowEqual> RowHashSet;
+
+// The rows of a Table, in one of these representations:
+//
+//     TREE:    A red-black tree ordered by RowCompare, (std::set).
+//     HASH:    A hash set. Each row's hash is computed once, when it is added, and kept by the set. Iteration is in
+//              no particular order.
+//     SORTED:  A vector ordered by RowCompare. Added rows are collected in a batch, which is sorted and merged into
+//              the vector by the next iteration. Duplicates are found with a hash set of all the rows. Removing a row
+//              shifts the rows following it.
+//
+// TREE and SORTED iterate in RowCompare order. Adding or removing rows invalidates iterators.
+class RowSet
+{
+public:
+    enum Kind
+    {
+        TREE,
+        HASH,
+        SORTED
+    };
+
+    class const_iterator
+    {
+    public:
+        typedef forward_iterator_tag iterator_category;
+        typedef Row* value_type;
+        typedef ptrdiff_t difference_type;
+        typedef Row* const* pointer;
+        typedef Row* const& reference;
+
+        reference operator*() const;
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator& that) const;
+        bool operator!=(const const_iterator& that) const;
+
+    private:
+        friend class RowSet;
+
+        Kind _kind;
+        set<Row*, RowCompare>::const_iterator _tree;
+        RowHashSet::const_iterator _hash;
+        vector<Row*>::const_iterator _sorted;
+    };
+
+    Kind kind() const;
+
+    // True if iteration is in RowCompare order
+    bool ordered() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    // Add the row, returning true, unless a matching row is present, in which case false is returned.
+    bool insert(Row* row);
+
+    // Return the row matching the given row, or NULL if there is none.
+    Row* find(Row* row) const;
+
+    // Remove the row matching the given row, returning it, (or NULL if there is none).
+    Row* erase(Row* row);
+
+    explicit RowSet(Kind kind = TREE);
+
+private:
+    void merge_batch() const;
+
+private:
+    Kind _kind;
+    set<Row*, RowCompare> _tree;
+    RowHashSet _hash;
+    mutable vector<Row*> _sorted;
+    mutable vector<Row*> _batch;        // Rows added to a SORTED set since the last iteration
+    RowHashSet _members;                // All rows of a SORTED set, for finding duplicates
+};
+
+class QueryScope;
+class Table;
+
+// A named column, for predicates and other code that access rows of different tables by column name. The name is
+// resolved to a position once per table, (the position is cached until a row of another table comes along), rather
+// than for every row.
+class NamedColumn
+{
+public:
+    // The value of this column in the given row. Throws TableException if the row's table has no such column.
+    const string &value(const Row *row);
+
+    explicit NamedColumn(const string &name);
+
+private:
+    string _name;
+    unsigned long _table_id;        // The table that _position is for, (0 for none)
+    unsigned _position;
+};
 
 class Table
 {
@@ -20,8 +135,14 @@ public:
     // The columns of this Table
     const ColumnNames &columns() const;
 
+    // An identifier that no other Table of this process has, (unlike the address of a deleted Table)
+    unsigned long id() const;
+
     // The contents of this Table
-    const RowSet& rows();
+    const RowSet& rows() const;
+
+    // Incremented by every change to the contents of this table
+    unsigned long version() const;
 
     // Add the given row to the table, returning true if the row was added, false if not (because a matching row
     // is already present). Following a successful add (i.e., returning true), the row is owned by the table, and
@@ -36,16 +157,32 @@ public:
     // Return true if a row matching the given row is present in the table, false otherwise.
     bool has(Row* row);
 
-    // Create a table with the given name and column names
-    Table(const string& name, const ColumnNames& columns);
+    // An estimate of the memory held by this table's rows, in bytes, (counting values shared with the rows of
+    // another table, e.g. by rename, in both tables).
+    size_t bytes() const;
+
+    // Create a table with the given name and column names, keeping its rows in a RowSet of the given kind
+    Table(const string& name, const ColumnNames& columns, RowSet::Kind kind = RowSet::TREE);
 
     // Destroy this table
     ~Table();
 
+private:
+    friend class Database;
+    friend class QueryScope;
+
+    void add_bytes(long delta);
+
 private:
     string _name;
     ColumnNames _columns;
     RowSet _rows;
+    size_t _bytes;
+    QueryScope *_scope;         // The scope the table belongs to, or NULL
+    unsigned long _id;
+    unsigned long _version;
+
+    static unsigned long _last_id;
 };
 
 
@@ -1,5 +1,8 @@
 #include <fstream>
 #include "Database.h"
+#include "Expression.h"
+#include "Plan.h"
+#include "ResultCache.h"
 #include "unittest.h"
 
 using namespace std;
@@ -10,6 +13,13 @@ static Table *user;
 static Table *routing;
 static Table *message;
 
+// Columns used by the predicates of the queries
+static NamedColumn birth_date("birth_date");
+static NamedColumn from_user_id("from_user_id");
+static NamedColumn send_date("send_date");
+static NamedColumn to_user_id("to_user_id");
+static NamedColumn username("username");
+
 // ------------------------------------------------------------------------------------------
 
 // UTILITIES
@@ -66,7 +76,7 @@ static bool row_eq(Row* x, Row* y)
     unsigned long n = xColumnNames.size();
     assert(yColumnNames.size() == n);
     for (unsigned long i = 0; i < n; i++) {
-        if (x->value(xColumnNames.at(i)) != y->value(yColumnNames.at(i))) {
+        if (x->at(i) != y->at(i)) {
             return false;
         }
     }
@@ -74,7 +84,7 @@ static bool row_eq(Row* x, Row* y)
 
 }
 
-static bool table_eq(Table* x, Table* y)
+static bool table_eq(const Table* x, const Table* y)
 {
     if (x->columns().size() != y->columns().size()) {
         return false;
@@ -115,7 +125,7 @@ void print_table(const char *label, Table *t)
             if (i > 0) {
                 printf("\t");
             }
-            printf("%s", row->value(t->columns().at(i)).c_str());
+            printf("%s", row->at(i).c_str());
         }
         printf("\n");
     }
@@ -198,7 +208,7 @@ static Table* IMPLEMENT_ME()
 
 static bool q0_predicate(Row *row)
 {
-    return row->value("from_user_id") == row->value("to_user_id");
+    return from_user_id.value(row) == to_user_id.value(row);
 }
 
 static void test_q0()
@@ -226,7 +236,7 @@ static void test_q0()
 
 static bool q1_predicate(Row *row)
 {
-    return row->value("username") == "Tweetii";
+    return username.value(row) == "Tweetii";
 }
 
 static void test_q1()
@@ -246,7 +256,7 @@ static void test_q1()
 
 static bool q2_predicate(Row *row)
 {
-    return row->value("username") == "Zyrianyhippy";
+    return username.value(row) == "Zyrianyhippy";
 }
 
 static void test_q2()
@@ -285,7 +295,7 @@ static void test_q2()
 static bool q3_predicate(Row *row)
 {
     // Date format is yyyy/mm/dd. substr(5, 5) extracts mm/dd.
-    return row->value("birth_date").substr(5, 5) == row->value("send_date").substr(5, 5);
+    return birth_date.value(row).substr(5, 5) == send_date.value(row).substr(5, 5);
 }
 
 static void test_q3()
@@ -311,12 +321,12 @@ static void test_q3()
 
 static bool q4_from_predicate(Row *row)
 {
-    return row->value("username") == "Unguiferous";
+    return username.value(row) == "Unguiferous";
 }
 
 static bool q4_to_predicate(Row *row)
 {
-    return row->value("username") == "Froglet";
+    return username.value(row) == "Froglet";
 }
 
 static void test_q4()
@@ -346,7 +356,7 @@ static void test_q4()
 
 static bool q5_predicate(Row *row)
 {
-    return row->value("send_date") == "2017/12/22";
+    return send_date.value(row) == "2017/12/22";
 }
 
 static void test_q5()
@@ -372,7 +382,7 @@ static void test_q5()
 
 static bool q6_predicate(Row *row)
 {
-    return row->value("username") == "Bamboozled";
+    return username.value(row) == "Bamboozled";
 }
 
 static void test_q6()
@@ -414,7 +424,7 @@ static void test_q6()
 
 static bool q7_predicate(Row *row)
 {
-    return row->value("send_date") == "2015/09/26";
+    return send_date.value(row) == "2015/09/26";
 }
 
 static void test_q7()
@@ -437,6 +447,341 @@ static void test_q7()
 
 //----------------------------------------------------------------------------------------------------------------------
 
+// Set operations, including on tables whose columns have different names
+
+static void test_set_operations()
+{
+    Table *r = Database::new_table("r", ColumnNames{"a", "b"});
+    Table *s = Database::new_table("s", ColumnNames{"x", "y"});
+    add(r, {"1", "a"});
+    add(r, {"2", "b"});
+    add(r, {"3", "c"});
+    add(s, {"2", "b"});
+    add(s, {"3", "x"});
+    add(s, {"4", "d"});
+    Table *control_union = Database::new_table("control_union", ColumnNames{"a", "b"});
+    add(control_union, {"1", "a"});
+    add(control_union, {"2", "b"});
+    add(control_union, {"3", "c"});
+    add(control_union, {"3", "x"});
+    add(control_union, {"4", "d"});
+    assert(table_eq(control_union, onion(r, s)));
+    Table *control_intersect = Database::new_table("control_intersect", ColumnNames{"a", "b"});
+    add(control_intersect, {"2", "b"});
+    assert(table_eq(control_intersect, intersect(r, s)));
+    Table *control_diff = Database::new_table("control_diff", ColumnNames{"a", "b"});
+    add(control_diff, {"1", "a"});
+    add(control_diff, {"3", "c"});
+    assert(table_eq(control_diff, diff(r, s)));
+    Table *control_diff_sr = Database::new_table("control_diff_sr", ColumnNames{"x", "y"});
+    add(control_diff_sr, {"3", "x"});
+    add(control_diff_sr, {"4", "d"});
+    assert(table_eq(control_diff_sr, diff(s, r)));
+    Table *empty = Database::new_table("empty", ColumnNames{"a", "b"});
+    assert(table_eq(r, onion(empty, r)));
+    assert(intersect(r, empty)->rows().empty());
+    assert(table_eq(r, diff(r, empty)));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Renaming shares the rows' values with the input
+
+static NamedColumn name("name");
+
+static bool name_predicate(Row *row)
+{
+    return name.value(row) == "Intaglio";
+}
+
+static void test_rename()
+{
+    Table *renamed = rename(user, NameMap({ {"user_id", "id"}, {"username", "name"}, {"birth_date", "born"} }));
+    assert(renamed->columns() == ColumnNames({"id", "name", "born"}));
+    assert(renamed->rows().size() == user->rows().size());
+    auto i = user->rows().begin();
+    for (Row *row : renamed->rows()) {
+        assert(row->table() == renamed);
+        assert(&row->data() == &(*i)->data());
+        assert(row->value("name") == (*i)->value("username"));
+        i++;
+    }
+    // The rows are read by the renamed table's column names.
+    Table *selected = select(renamed, name_predicate);
+    assert(selected->rows().size() == 1);
+    assert((*selected->rows().begin())->value("name") == "Intaglio");
+    assert(table_eq(selected, evaluate(select(lazy(renamed), name_predicate))));
+    // A change to either table leaves the other unchanged.
+    Table *r = Database::new_table("rename_r", ColumnNames{"a", "b"});
+    add(r, {"1", "x"});
+    Table *s = rename(r, NameMap({ {"a", "c"}, {"b", "d"} }));
+    assert(add(s, {"2", "y"}));
+    assert(remove(r, {"1", "x"}));
+    assert(r->rows().empty());
+    assert(s->rows().size() == 2);
+    assert(has(s, {"1", "x"}));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Lazy evaluation gives the same results as eager evaluation
+
+static void test_lazy()
+{
+    Table *q0 =
+        evaluate(
+            diff(
+                project(lazy(user), ColumnNames{"username"}),
+                project(
+                    join(
+                        rename(
+                            select(lazy(routing), q0_predicate),
+                            NameMap({ {"from_user_id", "user_id"}, {"to_user_id", "to_user_id"}, {"message_id", "message_id"} })),
+                        lazy(user)),
+                    ColumnNames{"username"})));
+    Table *control0 = Database::new_table(Database::new_table_name(), ColumnNames{"username"});
+    add(control0, {"Intaglio"});
+    add(control0, {"Unguiferous"});
+    assert(table_eq(control0, q0));
+    Table *q3 =
+        evaluate(
+            project(
+                select(
+                    join(
+                        join(
+                            rename(lazy(user), NameMap({ {"user_id", "to_user_id"}, {"username", "username"}, {"birth_date", "birth_date"} })),
+                            lazy(routing)),
+                        lazy(message)),
+                    q3_predicate),
+                ColumnNames{"username"}));
+    assert(table_eq(project(select(join(join(rename(user, NameMap({ {"user_id", "to_user_id"}, {"username", "username"}, {"birth_date", "birth_date"} })), routing), message), q3_predicate), ColumnNames{"username"}), q3));
+    assert(table_eq(product(user, message), evaluate(product(lazy(user), lazy(message)))));
+    Table *ids = project(user, ColumnNames{"user_id"});
+    Table *senders = rename(project(routing, ColumnNames{"from_user_id"}), NameMap({ {"from_user_id", "user_id"} }));
+    assert(table_eq(onion(ids, senders), evaluate(onion(lazy(ids), lazy(senders)))));
+    assert(table_eq(intersect(ids, senders), evaluate(intersect(lazy(ids), lazy(senders)))));
+    bool thrown = false;
+    try {
+        join(lazy(user), lazy(message));
+    } catch (JoinException& e) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Each kind of RowSet behaves the same, apart from the order of a hash set
+
+static Table *copy_of(Table *t, RowSet::Kind kind)
+{
+    Table *copy = Database::new_table(Database::new_table_name(), t->columns(), kind);
+    for (Row *row : t->rows()) {
+        add(copy, row->data());
+    }
+    return copy;
+}
+
+static void test_row_set_kinds()
+{
+    const RowSet::Kind kinds[] = {RowSet::TREE, RowSet::HASH, RowSet::SORTED};
+    Table *ids = project(user, ColumnNames{"user_id"});
+    Table *senders = rename(project(routing, ColumnNames{"from_user_id"}), NameMap({ {"from_user_id", "user_id"} }));
+    for (RowSet::Kind kind : kinds) {
+        Table *t = Database::new_table(Database::new_table_name(), ColumnNames{"a", "b"}, kind);
+        assert(t->rows().kind() == kind);
+        assert(add(t, {"2", "x"}));
+        assert(add(t, {"1", "y"}));
+        assert(!add(t, {"2", "x"}));
+        assert(add(t, {"3", "z"}));
+        assert(!add(t, {"1", "y"}));
+        assert(t->rows().size() == 3);
+        assert(has(t, {"1", "y"}));
+        assert(!has(t, {"1", "x"}));
+        assert(remove(t, {"2", "x"}));
+        assert(!remove(t, {"2", "x"}));
+        assert(!has(t, {"2", "x"}));
+        assert(add(t, {"2", "x"}));
+        assert(t->rows().size() == 3);
+        // The set operators and join give the same results for every combination of kinds.
+        Table *ids_copy = copy_of(ids, kind);
+        Table *senders_copy = copy_of(senders, kind);
+        if (kind != RowSet::HASH) {
+            assert(table_eq(ids, ids_copy));
+        }
+        assert(table_eq(onion(ids, senders), onion(ids_copy, senders)));
+        assert(table_eq(intersect(ids, senders), intersect(ids, senders_copy)));
+        assert(table_eq(diff(ids, senders), diff(ids_copy, senders_copy)));
+        assert(table_eq(diff(senders, ids), diff(senders_copy, ids)));
+        assert(table_eq(join(routing, message), join(copy_of(routing, kind), message)));
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Query scopes drop intermediate results
+
+static Table *q2_query()
+{
+    return project(
+        join(
+            join(
+                rename(
+                    select(user, q2_predicate),
+                    NameMap({ {"user_id", "from_user_id"}, {"username", "username"}, {"birth_date", "birth_date"} })),
+                routing),
+            message),
+        ColumnNames{ "send_date" });
+}
+
+static void test_query_scope()
+{
+    size_t n_tables = Database::n_tables();
+    size_t bytes = Database::bytes();
+    for (int i = 0; i < 3; i++) {
+        QueryScope scope;
+        q2_query();
+        assert(Database::n_tables() == n_tables + 5);
+        assert(scope.bytes() == Database::bytes() - bytes);
+        assert(scope.peak_bytes() >= scope.bytes());
+    }
+    // A long series of queries reaches a steady state.
+    assert(Database::n_tables() == n_tables);
+    assert(Database::bytes() == bytes);
+    // Kept results outlive the scope, and nested scopes count towards enclosing ones.
+    Table *q2;
+    {
+        QueryScope outer;
+        {
+            QueryScope inner;
+            q2 = inner.keep(q2_query());
+            assert(outer.peak_bytes() == inner.peak_bytes());
+            assert(inner.bytes() < outer.bytes());
+        }
+        assert(outer.bytes() == q2->bytes());
+        outer.keep(q2);
+        assert(outer.bytes() == 0);
+        // Inputs of product that it renames are dropped right away.
+        product(project(user, ColumnNames{"username"}), project(message, ColumnNames{"text"}));
+        assert(Database::n_tables() == n_tables + 4);
+    }
+    assert(Database::n_tables() == n_tables + 1);
+    assert(q2->rows().size() == 13);
+    Database::drop_table(q2);
+    assert(Database::n_tables() == n_tables);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Column handles
+
+static void test_column_handles()
+{
+    ColumnHandle handle(user->columns(), "birth_date");
+    assert(handle.position() == 2);
+    bool thrown = false;
+    try {
+        ColumnHandle(user->columns(), "text");
+    } catch (TableException& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    // A named column follows the rows from table to table, even when its position changes.
+    NamedColumn text("text");
+    Table *reordered = project(message, ColumnNames{"text", "message_id"});
+    for (Row *row : message->rows()) {
+        assert(&text.value(row) == &row->at(2));
+    }
+    for (Row *row : reordered->rows()) {
+        assert(&text.value(row) == &row->at(0));
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Compiled plans give the same results as eager evaluation
+
+static void test_compiled_plans()
+{
+    Table *senders = rename(project(routing, ColumnNames{"from_user_id"}), NameMap({ {"from_user_id", "user_id"} }));
+    // Projection and union eliminate duplicates as they stream.
+    Iterator *plan = compile(onion(project(lazy(routing), ColumnNames{"from_user_id"}), lazy(senders)));
+    for (int run = 0; run < 2; run++) {
+        unsigned n = 0;
+        plan->open();
+        for (Row *row = plan->next(); row != NULL; row = plan->next()) {
+            n++;
+        }
+        plan->close();
+        assert(n == senders->rows().size());
+    }
+    delete plan;
+    // A selection from a table returns the table's own rows.
+    plan = compile(select(lazy(routing), q0_predicate));
+    assert(plan->n_columns() == 3);
+    plan->open();
+    for (Row *row = plan->next(); row != NULL; row = plan->next()) {
+        assert(row->table() == routing);
+        assert(routing->rows().find(row) == row);
+    }
+    plan->close();
+    delete plan;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// Send dates of the messages from a user, whose id is the query's parameter
+
+static string sender;
+
+static bool sender_predicate(Row *row)
+{
+    return from_user_id.value(row) == sender;
+}
+
+static shared_ptr<const Table> send_dates(ResultCache &cache, const string &user_id)
+{
+    sender = user_id;
+    return cache.get(project(join(select(lazy(routing), sender_predicate), lazy(message)), ColumnNames{"send_date"}),
+                     {user_id});
+}
+
+static void test_result_cache()
+{
+    ResultCache cache;
+    shared_ptr<const Table> dates = send_dates(cache, "1012");
+    sender = "1012";
+    assert(table_eq(project(join(select(routing, sender_predicate), message), ColumnNames{"send_date"}), dates.get()));
+    assert(send_dates(cache, "1012") == dates);
+    assert(cache.hits() == 1 && cache.misses() == 1);
+    // Another parameter is another result.
+    shared_ptr<const Table> other_dates = send_dates(cache, "1009");
+    assert(other_dates != dates);
+    assert(send_dates(cache, "1009") == other_dates);
+    assert(cache.size() == 2);
+    // Changing a table invalidates the results that read it, (but not the tables that callers already have).
+    add(routing, {"1012", "1000", "1000002"});
+    shared_ptr<const Table> new_dates = send_dates(cache, "1012");
+    assert(new_dates != dates);
+    assert(new_dates->rows().size() == dates->rows().size() + 1);
+    remove(routing, {"1012", "1000", "1000002"});
+    assert(table_eq(send_dates(cache, "1012").get(), dates.get()));
+    assert(cache.misses() == 4);
+    // The least recently used result is discarded when the cache is full.
+    ResultCache small(1);
+    send_dates(small, "1012");
+    send_dates(small, "1009");
+    send_dates(small, "1012");
+    assert(small.size() == 1 && small.hits() == 0);
+    // Results of queries reading tables that aren't in the Database are not cached.
+    Table scratch("scratch", ColumnNames{"x"});
+    cache.clear();
+    cache.get(lazy(&scratch));
+    assert(cache.size() == 0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void test_queries(int argc, const char **argv)
 {
     if (argc < 2) {
@@ -454,6 +799,14 @@ void test_queries(int argc, const char **argv)
     ADD_TEST(test_q5);
     ADD_TEST(test_q6);
     ADD_TEST(test_q7);
+    ADD_TEST(test_set_operations);
+    ADD_TEST(test_rename);
+    ADD_TEST(test_lazy);
+    ADD_TEST(test_row_set_kinds);
+    ADD_TEST(test_query_scope);
+    ADD_TEST(test_column_handles);
+    ADD_TEST(test_compiled_plans);
+    ADD_TEST(test_result_cache);
     RUN_TESTS();
     free(db_dir);
 }
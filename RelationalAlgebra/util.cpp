@@ -21,7 +21,7 @@ void print_table(const char *label, Table *t)
             if (i > 0) {
                 printf("\t");
             }
-            printf("%s", row->value(t->columns().at(i)).c_str());
+            printf("%s", row->at(i).c_str());
         }
         printf("\n");
     }